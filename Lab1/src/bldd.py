@@ -8,10 +8,25 @@ Generates text or PDF reports.
 """
 
 import argparse
+import bz2
+import concurrent.futures
+import contextlib
+import csv
+import fnmatch
+import gzip
+import io
+import json
+import lzma
+import posixpath
+import shutil
+import subprocess
+import tarfile
 import textwrap
+import threading
 import os
+import struct
 import sys
-from collections import defaultdict
+from collections import defaultdict, deque, namedtuple
 import datetime
 
 # Third-party imports
@@ -26,11 +41,31 @@ except ImportError:
 
 PDF_SUPPORTED = True
 try:
+    from reportlab.lib import colors
     from reportlab.lib.styles import getSampleStyleSheet
-    from reportlab.platypus import Paragraph, SimpleDocTemplate, Spacer
+    from reportlab.pdfbase.pdfmetrics import stringWidth
+    from reportlab.platypus import (Paragraph, SimpleDocTemplate, Spacer,
+                                    Table, TableStyle)
 except ImportError:
     PDF_SUPPORTED = False
 
+# Diagnostic verbosity levels (see log())
+QUIET, NORMAL, VERBOSE = 0, 1, 2
+VERBOSITY = NORMAL
+LOG_STREAM = sys.stdout
+
+# Parallel scans (-j): files per worker task and tasks queued per worker
+SCAN_BATCH_SIZE = 64
+SCAN_BATCHES_IN_FLIGHT = 4
+
+# Report formats that are written while the scan is running
+STREAM_FORMATS = ('ndjson', 'csv')
+
+# PDF tables: rows per Table flowable (about one page, so tables rarely
+# need splitting) and the font used for their cells
+PDF_TABLE_ROWS = 60
+PDF_TABLE_FONT = ('Helvetica', 7)
+
 # ELF architecture mapping
 ARCH_MAP = {
     'x86':    'EM_386',
@@ -39,203 +74,1437 @@ ARCH_MAP = {
     'aarch64': 'EM_AARCH64',
 }
 
+# Trusted directories searched by the dynamic loader after RPATH/RUNPATH
+# and ld.so.cache, per e_machine (multiarch layout first, then legacy).
+DEFAULT_LIB_DIRS = {
+    'EM_386': [
+        '/lib/i386-linux-gnu', '/usr/lib/i386-linux-gnu',
+        '/lib32', '/usr/lib32', '/lib', '/usr/lib',
+    ],
+    'EM_X86_64': [
+        '/lib/x86_64-linux-gnu', '/usr/lib/x86_64-linux-gnu',
+        '/lib64', '/usr/lib64', '/lib', '/usr/lib',
+    ],
+    'EM_ARM': [
+        '/lib/arm-linux-gnueabihf', '/usr/lib/arm-linux-gnueabihf',
+        '/lib/arm-linux-gnueabi', '/usr/lib/arm-linux-gnueabi',
+        '/lib', '/usr/lib',
+    ],
+    'EM_AARCH64': [
+        '/lib/aarch64-linux-gnu', '/usr/lib/aarch64-linux-gnu',
+        '/lib64', '/usr/lib64', '/lib', '/usr/lib',
+    ],
+}
+
+LD_SO_CACHE = '/etc/ld.so.cache'
+LD_SO_CACHE_MAGIC = b'glibc-ld.so.cache1.1'
 
-def get_file_arch(path):
-    """Return the ELF e_machine value for an ELF file."""
-    with open(path, 'rb') as f:
-        elf = ELFFile(f)
-        return elf.header['e_machine']
+# Numeric e_machine values, for filtering on the raw ELF header
+EM_NUMBERS = {
+    'EM_386': 3,
+    'EM_ARM': 40,
+    'EM_X86_64': 62,
+    'EM_AARCH64': 183,
+}
 
+# e_ident plus e_type and e_machine
+ELF_IDENT_SIZE = 20
+ET_EXEC, ET_DYN = 2, 3
+
+# ELF program header and dynamic tags read by parse_dynamic_prefix()
+PT_LOAD, PT_DYNAMIC = 1, 2
+DT_NULL, DT_NEEDED, DT_STRTAB, DT_STRSZ = 0, 1, 5, 10
+DT_SONAME, DT_RPATH, DT_RUNPATH = 14, 15, 29
+
+# Compressed stream magic numbers accepted as -d targets
+COMPRESSION_MAGIC = (
+    (b'\x1f\x8b', 'gzip'),
+    (b'\x28\xb5\x2f\xfd', 'zstd'),
+    (b'\xfd7zXZ\x00', 'xz'),
+    (b'BZh', 'bzip2'),
+)
+CPIO_NEWC_MAGIC = (b'070701', b'070702')
+CPIO_TRAILER = 'TRAILER!!!'
+
+# OCI/Docker layer whiteouts
+WHITEOUT_PREFIX = '.wh.'
+WHITEOUT_OPAQUE = '.wh..wh..opq'
+
+# EF_ARM_ABI_FLOAT_HARD: armhf and armel objects cannot be mixed
+EF_ARM_ABI_FLOAT_HARD = 0x400
+
+# Dynamic section of one ELF object, as needed for dependency resolution.
+# imports maps requested undefined .dynsym names to their version
+# requirement (version, file) from .gnu.version_r, or None if unversioned.
+DynamicInfo = namedtuple(
+    'DynamicInfo',
+    ['machine', 'elfclass', 'flags', 'needed', 'rpath', 'runpath', 'soname',
+     'imports'],
+    defaults=(None,)
+)
+
+
+def read_elf_ident(f):
+    """
+    Return (e_type, e_machine) as integers from the first bytes of an
+    open file, or None if it is not an ELF file. Costs a single read.
+    """
+    head = f.read(ELF_IDENT_SIZE)
+    if len(head) < ELF_IDENT_SIZE or head[:4] != b'\x7fELF':
+        return None
+    endian = '<' if head[5] == 1 else '>'
+    return struct.unpack_from(endian + 'HH', head, 16)
+
+
+def get_version_requirements(elf):
+    """Return {versym index: (version, file)} from .gnu.version_r."""
+    requirements = {}
+    for section in elf.iter_sections():
+        if section['sh_type'] != 'SHT_GNU_verneed':
+            continue
+        for verneed, vernaux_iter in section.iter_versions():
+            for vernaux in vernaux_iter:
+                requirements[vernaux['vna_other']] = (
+                    vernaux.name, verneed.name
+                )
+    return requirements
 
-def get_needed_libs(path):
-    """Return a list of DT_NEEDED entries from the ELF .dynamic section."""
-    libs = []
-    with open(path, 'rb') as f:
-        elf = ELFFile(f)
-        section = elf.get_section_by_name('.dynamic')
 
-        if section is None:
-            return libs
+def get_imports(elf, symbols):
+    """
+    Return {name: (version, file) or None} for each of symbols that elf
+    references as an undefined .dynsym entry.
+    """
+    imports = {}
+    dynsym = elf.get_section_by_name('.dynsym')
+    if dynsym is None:
+        return imports
 
+    versym = None
+    for section in elf.iter_sections():
+        if section['sh_type'] == 'SHT_GNU_versym':
+            versym = section
+            break
+    requirements = None
+
+    for i, sym in enumerate(dynsym.iter_symbols()):
+        if sym.name not in symbols or sym['st_shndx'] != 'SHN_UNDEF':
+            continue
+        version = None
+        if versym is not None:
+            ndx = versym.get_symbol(i)['ndx']
+            # VER_NDX_LOCAL/VER_NDX_GLOBAL are decoded to strings
+            if isinstance(ndx, int):
+                if requirements is None:
+                    requirements = get_version_requirements(elf)
+                version = requirements.get(ndx & 0x7fff)
+        imports[sym.name] = version
+    return imports
+
+
+def find_export(elf, name):
+    """
+    Return the defined dynamic symbol name of elf, or None.
+
+    Looked up through DT_GNU_HASH (or the SysV DT_HASH) so only one hash
+    chain is walked; the linear .dynsym scan is a last resort.
+    """
+    for hash_type in ('SHT_GNU_HASH', 'SHT_HASH'):
+        for section in elf.iter_sections():
+            if section['sh_type'] == hash_type:
+                sym = section.get_symbol(name)
+                if sym is not None and sym['st_shndx'] == 'SHN_UNDEF':
+                    sym = None
+                return sym
+
+    dynsym = elf.get_section_by_name('.dynsym')
+    if dynsym is None:
+        return None
+    return next(
+        (sym for sym in dynsym.iter_symbols()
+         if sym.name == name and sym['st_shndx'] != 'SHN_UNDEF'),
+        None
+    )
+
+
+def parse_dynamic_stream(f, symbols=None):
+    """
+    Return the DynamicInfo of an open ELF file in a single parse.
+
+    If symbols is given, the undefined .dynsym references to them are
+    collected in the same parse.
+    """
+    needed = []
+    rpath = runpath = soname = None
+    elf = ELFFile(f)
+    section = elf.get_section_by_name('.dynamic')
+
+    if section is not None:
         for tag in section.iter_tags():
-            if tag.entry.d_tag == 'DT_NEEDED':
-                libs.append(tag.needed)
+            d_tag = tag.entry.d_tag
+            if d_tag == 'DT_NEEDED':
+                needed.append(tag.needed)
+            elif d_tag == 'DT_RPATH':
+                rpath = tag.rpath
+            elif d_tag == 'DT_RUNPATH':
+                runpath = tag.runpath
+            elif d_tag == 'DT_SONAME':
+                soname = tag.soname
+
+    return DynamicInfo(
+        machine=elf.header['e_machine'],
+        elfclass=elf.elfclass,
+        flags=elf.header['e_flags'],
+        needed=needed,
+        rpath=rpath,
+        runpath=runpath,
+        soname=soname,
+        imports=get_imports(elf, symbols) if symbols else None,
+    )
+
+
+class PrefixReader:
+    """
+    Forward-only reader over a non-seekable stream that keeps only the
+    bytes read so far, so an ELF member can be parsed without buffering
+    the part after its dynamic segment.
+
+    That saves the tail alone: PT_DYNAMIC sits in the writable segment
+    after .text and .rodata, so everything before it is kept, not just the
+    header bytes. The dynamic string table usually lies before the code,
+    and where it is only becomes known once .dynamic has been read.
+    """
+
+    def __init__(self, stream, head=b''):
+        self.stream = stream
+        self.buf = bytearray(head)
+
+    def ensure(self, end):
+        """Read until at least end bytes are buffered; raise on EOF."""
+        while len(self.buf) < end:
+            chunk = self.stream.read(max(end - len(self.buf), 65536))
+            if not chunk:
+                raise EOFError(f'truncated ELF file ({len(self.buf)} bytes)')
+            self.buf += chunk
+        return self.buf
+
 
-    return libs
+def parse_dynamic_prefix(reader):
+    """
+    Return the DynamicInfo of an ELF file read through a PrefixReader.
 
+    Parses only the ELF header, the program headers, the PT_DYNAMIC segment
+    and the dynamic string table. The stream is read up to the end of
+    PT_DYNAMIC, which in a linked object is most of its loadable part; the
+    non-allocated sections (.symtab, debug info) and the section headers
+    after it are never read. Used for archive members, where pyelftools
+    would need to seek to the section headers at the end of the file.
+    """
+    buf = reader.ensure(ELF_IDENT_SIZE)
+    is64 = buf[4] == 2
+    e = '<' if buf[5] == 1 else '>'
+    ehdr = e + ('HHIQQQIHHH' if is64 else 'HHIIIIIHHH')
+    buf = reader.ensure(16 + struct.calcsize(ehdr))
+    (_, machine, _, _, phoff, _, flags, _,
+     phentsize, phnum) = struct.unpack_from(ehdr, buf, 16)
 
-def is_elf_executable(path):
-    """Return True if path is an ELF executable or PIE."""
+    phdr = e + ('IIQQQQ' if is64 else 'IIIIII')
+    buf = reader.ensure(phoff + phnum * phentsize)
+    loads = []
+    dynamic = None
+    for i in range(phnum):
+        fields = struct.unpack_from(phdr, buf, phoff + i * phentsize)
+        if is64:
+            p_type, _, p_offset, p_vaddr, _, p_filesz = fields
+        else:
+            p_type, p_offset, p_vaddr, _, p_filesz, _ = fields
+        if p_type == PT_LOAD:
+            loads.append((p_vaddr, p_offset, p_filesz))
+        elif p_type == PT_DYNAMIC:
+            dynamic = (p_offset, p_filesz)
+
+    entries = []
+    if dynamic is not None:
+        dyn = e + ('qQ' if is64 else 'iI')
+        size = struct.calcsize(dyn)
+        buf = reader.ensure(dynamic[0] + dynamic[1])
+        for off in range(dynamic[0], dynamic[0] + dynamic[1], size):
+            tag, val = struct.unpack_from(dyn, buf, off)
+            if tag == DT_NULL:
+                break
+            entries.append((tag, val))
+
+    tags = dict(entries)
+    strtab = None
+    if DT_STRTAB in tags:
+        # DT_STRTAB is a virtual address; map it through PT_LOAD
+        vaddr = tags[DT_STRTAB]
+        for p_vaddr, p_offset, p_filesz in loads:
+            if p_vaddr <= vaddr < p_vaddr + p_filesz:
+                start = vaddr - p_vaddr + p_offset
+                buf = reader.ensure(start + tags.get(DT_STRSZ, 0))
+                strtab = bytes(buf[start:start + tags.get(DT_STRSZ, 0)])
+                break
+
+    def string(off):
+        if strtab is None:
+            return None
+        return strtab[off:strtab.find(b'\0', off)].decode(errors='replace')
+
+    machine = next(
+        (name for name, num in EM_NUMBERS.items() if num == machine), machine
+    )
+    return DynamicInfo(
+        machine=machine,
+        elfclass=64 if is64 else 32,
+        flags=flags,
+        needed=[string(v) for t, v in entries if t == DT_NEEDED],
+        rpath=string(tags[DT_RPATH]) if DT_RPATH in tags else None,
+        runpath=string(tags[DT_RUNPATH]) if DT_RUNPATH in tags else None,
+        soname=string(tags[DT_SONAME]) if DT_SONAME in tags else None,
+    )
+
+
+def parse_dynamic(path):
+    """Return the DynamicInfo of an ELF file in a single parse."""
+    with open(path, 'rb') as f:
+        return parse_dynamic_stream(f)
+
+
+def read_ld_so_cache(path):
+    """Return {soname: [paths]} from a glibc ld.so.cache, or {} if absent."""
+    entries = defaultdict(list)
     try:
         with open(path, 'rb') as f:
-            # Check for ELF magic number
-            magic = f.read(4)
-            if magic != b'\x7fELF':
-                print(f"Not an ELF file: {path}")
-                return False
+            data = f.read()
+    except OSError:
+        return entries
 
-            f.seek(0)
-            elf = ELFFile(f)
-            etype = elf.header['e_type']
+    # Old-format caches prepend a libc5 table before the new header
+    start = data.find(LD_SO_CACHE_MAGIC)
+    if start < 0:
+        return entries
+
+    nlibs, = struct.unpack_from('<I', data, start + 20)
+    # struct cache_file_new: 48-byte header, 24-byte file_entry_new
+    for i in range(nlibs):
+        _, key, value = struct.unpack_from('<iII', data, start + 48 + 24 * i)
+        name = data[start + key:data.index(b'\0', start + key)]
+        lib = data[start + value:data.index(b'\0', start + value)]
+        entries[name.decode(errors='replace')].append(
+            lib.decode(errors='replace')
+        )
+    return entries
+
+
+class LibraryResolver:
+    """
+    Resolve DT_NEEDED entries to files the way ld.so would and compute
+    transitive dependency closures.
+
+    Every shared object is parsed at most once and closures are memoized
+    per (object, inherited RPATH) so executables sharing libc do not
+    re-walk its dependency DAG.
+    """
+
+    def __init__(self, sysroot='/'):
+        self.sysroot = sysroot
+        self._top = os.path.realpath(sysroot)
+        self._real = {}      # path -> realpath inside the sysroot
+        self._info = {}      # realpath -> DynamicInfo or None
+        self._lookup = {}    # (name, abi, search dirs) -> path or None
+        self._closure = {}   # (realpath, inherited) -> frozenset of names
+        self._exports = {}   # realpath -> {symbol: bool}
+        self._ld_cache = None
+
+    def _root(self, path):
+        """Map an absolute path of the scanned system into the sysroot."""
+        if self.sysroot == '/' or not os.path.isabs(path):
+            return path
+        return os.path.join(self.sysroot, path.lstrip('/'))
+
+    def _realpath(self, path):
+        """
+        os.path.realpath() confined to the sysroot: an absolute symlink
+        target is taken relative to it, as it would be on the scanned
+        system, and '..' stops at its top. Paths outside the sysroot (the
+        scanned tree may be elsewhere) resolve as usual. Returns None for
+        a symlink loop, where the kernel would fail with ELOOP.
+        """
+        path = os.path.abspath(path)
+        if path in self._real:
+            return self._real[path]
+        rel = None
+        if self._top != '/':
+            for top in (os.path.abspath(self.sysroot), self._top):
+                if path == top or path.startswith(top + os.sep):
+                    rel = path[len(top):]
+                    break
+        if rel is None:
+            real = os.path.realpath(path)
+        else:
+            parts = deque(c for c in rel.split('/') if c)
+            done = []
+            hops = 0
+            while parts:
+                part = parts.popleft()
+                if part == '.':
+                    continue
+                if part == '..':
+                    if done:
+                        done.pop()
+                    continue
+                cur = os.path.join(self._top, *done, part)
+                if os.path.islink(cur):
+                    hops += 1
+                    if hops > 40:
+                        done = None
+                        break
+                    target = os.readlink(cur)
+                    if target.startswith('/'):
+                        done = []
+                    parts.extendleft(
+                        reversed([c for c in target.split('/') if c])
+                    )
+                else:
+                    done.append(part)
+            real = os.path.join(self._top, *done) if done is not None else None
+        self._real[path] = real
+        return real
+
+    def info(self, path):
+        """Return the cached DynamicInfo for path, parsing it on first use."""
+        real = self._realpath(path)
+        if real is None:
+            return None
+        if real not in self._info:
+            try:
+                self._info[real] = parse_dynamic(real)
+            except Exception:
+                self._info[real] = None
+        return self._info[real]
+
+    def _expand(self, dirs, origin, elfclass):
+        """Split an RPATH/RUNPATH string and substitute $ORIGIN and $LIB."""
+        if not dirs:
+            return ()
+        lib = 'lib64' if elfclass == 64 else 'lib'
+        result = []
+        for d in dirs.split(':'):
+            if not d:
+                continue
+            # $ORIGIN already points into the scanned tree
+            relative = '$ORIGIN' in d or '${ORIGIN}' in d
+            for var, val in (('ORIGIN', origin), ('LIB', lib)):
+                d = d.replace('${%s}' % var, val).replace('$' + var, val)
+            result.append(d if relative else self._root(d))
+        return tuple(result)
+
+    def _abi_matches(self, info, parent):
+        """Return True if info can be loaded into parent's process."""
+        if info is None:
+            return False
+        if (info.machine, info.elfclass) != (parent.machine, parent.elfclass):
+            return False
+        if parent.machine == 'EM_ARM':
+            return ((info.flags ^ parent.flags) & EF_ARM_ABI_FLOAT_HARD) == 0
+        return True
+
+    def _candidates(self, name, dirs):
+        for d in dirs:
+            yield os.path.normpath(os.path.join(d, name))
+        if self._ld_cache is None:
+            self._ld_cache = read_ld_so_cache(self._root(LD_SO_CACHE))
+        for path in self._ld_cache.get(name, ()):
+            yield self._root(path)
+
+    def resolve(self, name, parent, parent_path, inherited=()):
+        """
+        Return the path DT_NEEDED name resolves to when requested by the
+        object at parent_path, or None if it cannot be found.
+
+        Search order follows ld.so: DT_RPATH of the object and its loaders
+        (only if the object has no DT_RUNPATH), DT_RUNPATH, ld.so.cache,
+        then the default directories for the object's architecture.
+        LD_LIBRARY_PATH is ignored as it belongs to the scanning host.
+
+        A name with a '/' is not searched for. An absolute one is taken
+        inside the sysroot. ld.so opens a relative one from the process's
+        current directory, which a static scan cannot know, so it is taken
+        relative to the requesting object's directory instead.
+        """
+        origin = os.path.dirname(os.path.abspath(parent_path))
+        if '/' in name:
+            if name.startswith('/'):
+                path = self._root(name)
+            else:
+                path = os.path.join(origin, name)
+            return path if self._abi_matches(self.info(path), parent) else None
+
+        dirs = ()
+        if not parent.runpath:
+            dirs += self._expand(parent.rpath, origin, parent.elfclass)
+            dirs += inherited
+        dirs += self._expand(parent.runpath, origin, parent.elfclass)
+        dirs += tuple(
+            self._root(d) for d in DEFAULT_LIB_DIRS.get(parent.machine, ())
+        )
+
+        key = (name, parent.machine, parent.elfclass,
+               parent.flags & EF_ARM_ABI_FLOAT_HARD, dirs)
+        if key not in self._lookup:
+            self._lookup[key] = next(
+                (p for p in self._candidates(name, dirs)
+                 if self._realpath(p) and os.path.isfile(self._realpath(p))
+                 and self._abi_matches(self.info(p), parent)),
+                None
+            )
+        return self._lookup[key]
+
+    def exports(self, path, names):
+        """
+        Return the set of names the shared object at path defines.
+
+        The object is parsed once for all names not looked up in it before.
+        """
+        real = self._realpath(path)
+        known = self._exports.setdefault(real, {})
+        missing = [name for name in names if name not in known]
+        if missing:
+            try:
+                with open(real, 'rb') as f:
+                    elf = ELFFile(f)
+                    for name in missing:
+                        known[name] = find_export(elf, name) is not None
+            except Exception:
+                known.update(dict.fromkeys(missing, False))
+        return {name for name in names if known[name]}
+
+    def dependency_paths(self, path, info, transitive=False):
+        """
+        Return the resolved paths of the DT_NEEDED entries of path, in
+        breadth-first load order when transitive.
+        """
+        result = []
+        seen = set()
+        queue = [(path, info, ())]
+        while queue:
+            obj, obj_info, inherited = queue.pop(0)
+            origin = os.path.dirname(os.path.abspath(obj))
+            child_inherited = inherited
+            if not obj_info.runpath:
+                child_inherited = self._expand(
+                    obj_info.rpath, origin, obj_info.elfclass
+                ) + inherited
+            for lib in obj_info.needed:
+                dep = self.resolve(lib, obj_info, obj, inherited)
+                if dep is None or self._realpath(dep) in seen:
+                    continue
+                seen.add(self._realpath(dep))
+                result.append(dep)
+                if transitive:
+                    queue.append((dep, self.info(dep), child_inherited))
+        return result
+
+    def closure(self, path, info):
+        """Return the set of all library names path depends on."""
+        names, _ = self._walk(path, info, (), set())
+        return names
+
+    def _walk(self, path, info, inherited, active):
+        """
+        Depth-first closure. Returns (names, complete); results cut short
+        by a dependency cycle are not memoized.
+        """
+        real = self._realpath(path)
+        key = (real, inherited)
+        if key in self._closure:
+            return self._closure[key], True
+        if key in active:
+            return frozenset(), False
+
+        active.add(key)
+        origin = os.path.dirname(os.path.abspath(path))
+        child_inherited = inherited
+        if not info.runpath:
+            child_inherited = (
+                self._expand(info.rpath, origin, info.elfclass) + inherited
+            )
+
+        names = set(info.needed)
+        complete = True
+        for lib in info.needed:
+            dep = self.resolve(lib, info, path, inherited)
+            if dep is None:
+                continue
+            sub, ok = self._walk(
+                dep, self.info(dep), child_inherited, active
+            )
+            names |= sub
+            complete = complete and ok
+        active.discard(key)
+
+        names = frozenset(names)
+        if complete:
+            self._closure[key] = names
+        return names, complete
+
+
+def log(level, msg):
+    """Print a diagnostic message if the verbosity level allows it."""
+    if VERBOSITY >= level:
+        print(msg, file=LOG_STREAM)
+
+
+def arch_name(machine):
+    """Return the ARCH_MAP key for an e_machine value, or the value itself."""
+    return next((k for k, v in ARCH_MAP.items() if v == machine), machine)
+
+
+def is_excluded(path, name, excludes):
+    """
+    Return True if path matches an --exclude glob. Patterns containing a
+    slash match the full path, others only the file or directory name.
+    """
+    for pattern in excludes:
+        target = path if '/' in pattern else name
+        if fnmatch.fnmatchcase(target, pattern):
+            return True
+    return False
+
+
+def iter_files(root, excludes=(), one_file_system=False):
+    """
+    Yield the path of every regular file under root exactly once.
+
+    Uses d_type from scandir, so plain files and directories cost no
+    stat call. Excluded directories are pruned without being read.
+    Special files (FIFOs, sockets, devices) are never opened. A symlink
+    is skipped if its target lies inside the scanned tree, since the
+    target is reported under its own path. Hardlinks are deduplicated
+    later by the caller, which already holds the file open.
+    """
+    root = root.rstrip('/') or '/'
+    real_root = os.path.realpath(root)
+    root_dev = os.stat(root).st_dev
+    stack = [root]
+
+    while stack:
+        dirpath = stack.pop()
+        try:
+            it = os.scandir(dirpath)
+        except OSError as e:
+            log(QUIET, f"Cannot read directory {dirpath}: {e}")
+            continue
+
+        with it:
+            for entry in it:
+                path = entry.path
+                if is_excluded(path, entry.name, excludes):
+                    log(VERBOSE, f"Excluded: {path}")
+                    continue
+                try:
+                    if entry.is_dir(follow_symlinks=False):
+                        if (one_file_system and
+                                entry.stat(follow_symlinks=False).st_dev
+                                != root_dev):
+                            log(VERBOSE, f"Other filesystem: {path}")
+                            continue
+                        stack.append(path)
+                    elif entry.is_file(follow_symlinks=False):
+                        yield path
+                    elif entry.is_symlink() and entry.is_file():
+                        target = os.path.realpath(path)
+                        inside = (target + '/').startswith(
+                            real_root.rstrip('/') + '/'
+                        )
+                        if inside and not is_excluded(
+                                target, os.path.basename(target), excludes):
+                            log(VERBOSE, f"Symlink into tree: {path}")
+                            continue
+                        yield path
+                except OSError as e:
+                    log(VERBOSE, f"Cannot stat {path}: {e}")
+
+
+def examine_file(path, wanted=None, symbols=None, seen=None):
+    """
+    Return (link_key, info) for an ELF executable, or None to skip path.
+
+    The file is opened once: the ELF header is checked with a single small
+    read, including the e_machine filter wanted, before pyelftools parses
+    it. link_key is (st_dev, st_ino) for files with several links and None
+    otherwise; if a seen set is given, such files are deduplicated before
+    parsing.
+    """
+    log(VERBOSE, f"\nChecking file: {path}")
+    try:
+        with open(path, 'rb') as f:
+            ident = read_elf_ident(f)
+            if ident is None:
+                log(VERBOSE, f"Not an ELF file: {path}")
+                return None
+            etype, machine = ident
             # ET_EXEC=2 or ET_DYN=3 for PIE
-            is_exec = etype in ('ET_EXEC', 'ET_DYN')
-            if not is_exec:
-                print(f"Not an executable: {path} (type: {etype})")
-            return is_exec
+            if etype not in (ET_EXEC, ET_DYN):
+                log(VERBOSE, f"Not an executable: {path} (type: {etype})")
+                return None
+            if wanted is not None and machine != EM_NUMBERS[wanted]:
+                log(VERBOSE, f"Architecture mismatch: {machine} != {wanted}")
+                return None
 
+            key = None
+            st = os.fstat(f.fileno())
+            if st.st_nlink > 1 or os.path.islink(path):
+                key = (st.st_dev, st.st_ino)
+                if seen is not None:
+                    if key in seen:
+                        log(VERBOSE,
+                            f"Already scanned via another link: {path}")
+                        return None
+                    seen.add(key)
+
+            f.seek(0)
+            return key, parse_dynamic_stream(f, symbols)
     except Exception as e:
-        print(f"Error checking ELF file {path}: {e}")
-        return False
+        log(QUIET, f"Error checking ELF file {path}: {e}")
+        return None
 
 
-def scan_directory(root, libraries, arch_filter):
-    """Scan root for ELF executables that depend on libraries."""
-    usage = defaultdict(list)
-    all_libs = defaultdict(list)
-    print(f"Scanning directory: {root}")
-    print(f"Looking for libraries: {libraries}")
-    print(f"Architecture filter: {arch_filter}")
+def _examine_batch(paths, wanted, symbols):
+    """Worker for parallel scans: examine_file() over a batch of paths."""
+    results = []
+    for path in paths:
+        result = examine_file(path, wanted, symbols)
+        if result is not None:
+            results.append((path,) + result)
+    return results
+
 
-    for dirpath, _, files in os.walk(root):
-        for name in files:
-            path = os.path.join(dirpath, name)
-            print(f"\nChecking file: {path}")
+def iter_examined(paths, wanted, symbols, jobs):
+    """
+    Yield (path, info) for the executables among paths, deduplicating
+    hardlinks. With jobs > 1, batches are parsed in worker processes; at
+    most a few batches per worker are in flight, so memory stays bounded
+    however large the tree is, and results keep the traversal order.
+    """
+    seen = set()
+    if jobs <= 1:
+        for path in paths:
+            result = examine_file(path, wanted, symbols, seen)
+            if result is not None:
+                yield path, result[1]
+        return
 
-            if not is_elf_executable(path):
-                print(f"Not an ELF executable: {path}")
+    def batches():
+        batch = []
+        for path in paths:
+            batch.append(path)
+            if len(batch) == SCAN_BATCH_SIZE:
+                yield batch
+                batch = []
+        if batch:
+            yield batch
+
+    with concurrent.futures.ProcessPoolExecutor(jobs) as pool:
+        pending = deque()
+        for batch in batches():
+            pending.append(
+                pool.submit(_examine_batch, batch, wanted, symbols)
+            )
+            if len(pending) < jobs * SCAN_BATCHES_IN_FLIGHT:
                 continue
+            yield from _dedupe(pending.popleft().result(), seen)
+        while pending:
+            yield from _dedupe(pending.popleft().result(), seen)
+
+
+def _dedupe(results, seen):
+    for path, key, info in results:
+        if key is not None:
+            if key in seen:
+                log(VERBOSE, f"Already scanned via another link: {path}")
+                continue
+            seen.add(key)
+        yield path, info
+
+
+def iter_executables(root, arch_filter, resolver=None,
+                     excludes=(), one_file_system=False, symbols=None,
+                     jobs=1):
+    """
+    Yield (path, arch, needed, info) for each ELF executable under root
+    as soon as it is parsed. info.imports holds the references to symbols.
+    Files with several hardlinks are reported once per (st_dev, st_ino).
+
+    If a LibraryResolver is given, needed is the transitive dependency
+    closure of the executable instead of its direct DT_NEEDED entries.
+    Closures are computed in this process so their memo is shared.
+    """
+    if not os.path.isdir(root):
+        try:
+            yield from iter_archive_executables(root, arch_filter, excludes,
+                                                symbols)
+        # EOFError: a truncated compressed stream
+        except (OSError, EOFError, tarfile.TarError, ValueError) as e:
+            log(QUIET, f"Error reading archive {root}: {e}")
+            sys.exit(1)
+        return
+
+    wanted = None if arch_filter == 'all' else ARCH_MAP[arch_filter]
+    paths = iter_files(root, excludes, one_file_system)
+
+    for path, info in iter_examined(paths, wanted, symbols, jobs):
+        log(VERBOSE, f"File architecture: {info.machine}")
+        needed = info.needed
+        if resolver is not None:
+            needed = sorted(resolver.closure(path, info))
+        log(VERBOSE, f"Found dependencies: {needed}")
+
+        yield path, arch_name(info.machine), needed, info
+
+
+def open_decompressed(f):
+    """
+    Return a stream yielding the decompressed contents of the binary
+    stream f, sniffing gzip, zstd, xz and bzip2 by magic number. zstd uses
+    the zstandard module if installed, otherwise the zstd command.
+    """
+    if not hasattr(f, 'peek'):
+        f = io.BufferedReader(f)
+    head = f.peek(6)[:6]
+    kind = next((k for m, k in COMPRESSION_MAGIC if head.startswith(m)), None)
+    if kind == 'gzip':
+        return gzip.GzipFile(fileobj=f)
+    if kind == 'xz':
+        return lzma.LZMAFile(f)
+    if kind == 'bzip2':
+        return bz2.BZ2File(f)
+    if kind == 'zstd':
+        try:
+            import zstandard
+            return zstandard.ZstdDecompressor().stream_reader(f)
+        except ImportError:
+            pass
+        if shutil.which('zstd') is None:
+            raise ValueError('zstd input needs the zstandard module or zstd')
+        proc = subprocess.Popen(['zstd', '-dc'], stdin=subprocess.PIPE,
+                                stdout=subprocess.PIPE)
+        return io.BufferedReader(_ZstdPipe(proc, f))
+    return f
+
+
+class _ZstdPipe(io.RawIOBase):
+    """
+    Decompress through the zstd command. The compressed stream may itself
+    be a member of an outer archive, so it is fed to zstd from a thread.
+    """
+
+    def __init__(self, proc, source):
+        self.proc = proc
+        self.feeder = threading.Thread(
+            target=self._feed, args=(source,), daemon=True
+        )
+        self.feeder.start()
+
+    def _feed(self, source):
+        try:
+            shutil.copyfileobj(source, self.proc.stdin, 1 << 20)
+        except BrokenPipeError:
+            pass
+        finally:
+            self.proc.stdin.close()
+
+    def readable(self):
+        return True
+
+    def readinto(self, b):
+        data = self.proc.stdout.read(len(b))
+        b[:len(data)] = data
+        return len(data)
+
+    def close(self):
+        self.proc.stdout.close()
+        self.proc.wait()
+        super().close()
+
+
+def archive_path(name):
+    """Normalize a member name ('./usr/bin/ls') to an absolute path."""
+    return posixpath.normpath('/' + name)
+
+
+def iter_tar_members(stream):
+    """
+    Yield (path, fileobj) for each regular file of a tar stream, read
+    sequentially. Hardlink members are skipped because their target was
+    already yielded. Whiteouts are yielded with a None fileobj.
+    """
+    with tarfile.open(fileobj=stream, mode='r|') as tar:
+        for member in tar:
+            path = archive_path(member.name)
+            if posixpath.basename(path).startswith(WHITEOUT_PREFIX):
+                yield path, None
+            elif member.isreg():
+                yield path, tar.extractfile(member)
+
+
+def iter_cpio_members(stream):
+    """
+    Yield (path, fileobj) for each regular file of a newc cpio stream, as
+    written by 'cpio -H newc' for initramfs images. Hardlinked files carry
+    their data only in the last link, so empty duplicates are skipped.
+    """
+    while True:
+        header = stream.read(110)
+        if len(header) < 110 or header[:6] not in CPIO_NEWC_MAGIC:
+            raise ValueError('corrupt newc cpio header')
+        fields = [int(header[6 + 8 * i:14 + 8 * i], 16) for i in range(13)]
+        mode, filesize, namesize = fields[1], fields[6], fields[11]
+        name = stream.read(namesize)[:-1].decode(errors='replace')
+        stream.read((4 - (110 + namesize) % 4) % 4)
+        if name == CPIO_TRAILER:
+            return
+
+        member = _LimitedReader(stream, filesize)
+        if (mode & 0o170000) == 0o100000 and filesize:
+            yield archive_path(name), member
+        while member.read(1 << 20):
+            pass
+        stream.read((4 - filesize % 4) % 4)
+
+
+class _LimitedReader(io.RawIOBase):
+    """Expose the next size bytes of a stream as a file of its own."""
+
+    def __init__(self, stream, size):
+        self.stream = stream
+        self.left = size
+
+    def readable(self):
+        return True
+
+    def read(self, size=-1):
+        if size is None or size < 0 or size > self.left:
+            size = self.left
+        data = self.stream.read(size)
+        self.left -= len(data)
+        return data
+
+    def readinto(self, b):
+        data = self.read(len(b))
+        b[:len(data)] = data
+        return len(data)
+
+
+def is_archive(path):
+    """
+    Return True if path starts like an input iter_archive_executables()
+    reads: a compressed stream, a newc cpio or a tar archive.
+    """
+    with open(path, 'rb') as f:
+        head = f.read(512)
+    return (any(head.startswith(m) for m, _ in COMPRESSION_MAGIC)
+            or head[:6] in CPIO_NEWC_MAGIC
+            or head[257:262] == b'ustar'
+            or tarfile.is_tarfile(path))
+
+
+def iter_archive_members(stream):
+    """Dispatch a decompressed archive stream to the tar or cpio reader."""
+    stream = io.BufferedReader(stream) if not hasattr(stream, 'peek') \
+        else stream
+    if stream.peek(6)[:6] in CPIO_NEWC_MAGIC:
+        return iter_cpio_members(stream)
+    return iter_tar_members(stream)
+
+
+def read_image_layers(path):
+    """
+    Return the layer blob names of a 'docker save' or OCI image tarball,
+    bottom layer first, or None if path is a plain archive.
+    """
+    try:
+        tar = tarfile.open(path, 'r:')
+    except tarfile.TarError:
+        return None
+    with tar:
+        names = set(tar.getnames())
+        if 'manifest.json' in names:
+            manifest = json.load(tar.extractfile('manifest.json'))
+            return manifest[0]['Layers']
+        if 'index.json' in names and 'oci-layout' in names:
+            def blob(digest):
+                algo, digest = digest.split(':', 1)
+                return f'blobs/{algo}/{digest}'
+            index = json.load(tar.extractfile('index.json'))
+            manifest = json.load(
+                tar.extractfile(blob(index['manifests'][0]['digest']))
+            )
+            return [blob(layer['digest']) for layer in manifest['layers']]
+    return None
+
 
+def iter_image_members(path, layers):
+    """
+    Yield (path, fileobj) for the files visible in the merged image.
+
+    Layers are read top-down, so a file shadowed by an upper layer, or
+    removed by a '.wh.NAME' or '.wh..wh..opq' whiteout, is skipped while
+    streaming instead of being extracted and deleted afterwards.
+    """
+    shadowed = set()   # paths provided or deleted by upper layers
+    opaque = set()     # directories made opaque by upper layers
+
+    def hidden(p):
+        if p in shadowed:
+            return True
+        parent = posixpath.dirname(p)
+        while parent != '/':
+            if parent in shadowed or parent in opaque:
+                return True
+            parent = posixpath.dirname(parent)
+        return '/' in opaque
+
+    with tarfile.open(path, 'r:') as image:
+        for layer in reversed(layers):
+            log(VERBOSE, f"Reading layer: {layer}")
+            added, added_opaque = set(), set()
+            stream = open_decompressed(image.extractfile(layer))
+            for member, fileobj in iter_archive_members(stream):
+                name = posixpath.basename(member)
+                directory = posixpath.dirname(member)
+                if name == WHITEOUT_OPAQUE:
+                    added_opaque.add(directory)
+                elif fileobj is None:
+                    added.add(posixpath.join(
+                        directory, name[len(WHITEOUT_PREFIX):]
+                    ))
+                elif not hidden(member):
+                    added.add(member)
+                    yield member, fileobj
+            shadowed |= added
+            opaque |= added_opaque
+
+
+def iter_archive_executables(archive, arch_filter, excludes=(), symbols=None):
+    """
+    Yield (path, arch, needed, info) for the ELF executables inside a tar,
+    tar.gz/xz/bz2/zst, newc cpio(.gz) or container image, without
+    extracting anything to disk. Paths are reported as in the archive.
+
+    Non-ELF members are skipped after a 20-byte read; ELF members are
+    read only up to their dynamic string table, unless symbols need the
+    whole member for pyelftools.
+    """
+    wanted = None if arch_filter == 'all' else ARCH_MAP[arch_filter]
+    layers = read_image_layers(archive)
+
+    with open(archive, 'rb') as f:
+        if layers is not None:
+            members = iter_image_members(archive, layers)
+        else:
+            members = iter_archive_members(open_decompressed(f))
+
+        for path, fileobj in members:
+            if fileobj is None:
+                continue
+            if is_excluded(path, posixpath.basename(path), excludes):
+                log(VERBOSE, f"Excluded: {path}")
+                continue
+            log(VERBOSE, f"\nChecking member: {path}")
             try:
-                arch = get_file_arch(path)
-                print(f"File architecture: {arch}")
+                head = fileobj.read(ELF_IDENT_SIZE)
+                ident = read_elf_ident(io.BytesIO(head))
+                if ident is None:
+                    log(VERBOSE, f"Not an ELF file: {path}")
+                    continue
+                etype, machine = ident
+                if etype not in (ET_EXEC, ET_DYN):
+                    log(VERBOSE, f"Not an executable: {path} (type: {etype})")
+                    continue
+                if wanted is not None and machine != EM_NUMBERS[wanted]:
+                    log(VERBOSE, f"Architecture mismatch: {machine} != {wanted}")
+                    continue
+                if symbols:
+                    member = io.BytesIO(head + fileobj.read())
+                    info = parse_dynamic_stream(member, symbols)
+                else:
+                    info = parse_dynamic_prefix(PrefixReader(fileobj, head))
             except Exception as e:
-                print(f"Error getting architecture: {e}")
+                log(QUIET, f"Error checking ELF member {path}: {e}")
                 continue
 
-            if arch_filter != 'all' and arch != ARCH_MAP[arch_filter]:
-                print(
-                    f"Architecture mismatch: {arch} != {ARCH_MAP[arch_filter]}"
-                    )
-                continue
+            log(VERBOSE, f"Found dependencies: {info.needed}")
+            yield path, arch_name(info.machine), info.needed, info
 
-            needed = get_needed_libs(path)
-            print(f"Found dependencies: {needed}")
 
-            # If no specific libraries were provided, collect all libraries
-            if not libraries:
-                for lib in needed:
-                    all_libs[lib].append(path)
-            else:
-                for lib in libraries:
-                    if lib in needed:
-                        print(f"Found match: {lib} in {path}")
-                        usage[lib].append(path)
+def log_scan_parameters(root, libraries, arch_filter, resolver):
+    log(NORMAL, f"Scanning directory: {root}")
+    log(NORMAL, f"Looking for libraries: {libraries}")
+    log(NORMAL, f"Architecture filter: {arch_filter}")
+    if resolver is not None:
+        log(NORMAL, f"Transitive resolution (sysroot: {resolver.sysroot})")
+
+
+def scan_directory(root, libraries, arch_filter, resolver=None, **walk):
+    """
+    Scan root for ELF executables that depend on libraries.
+
+    Returns {library: [(path, arch)]}; the arch is kept from the scan so
+    reports never reopen the executables.
+    """
+    usage = defaultdict(list)
+    all_libs = defaultdict(list)
+    log_scan_parameters(root, libraries, arch_filter, resolver)
+
+    for path, arch, needed, _ in iter_executables(root, arch_filter,
+                                                  resolver, **walk):
+        # If no specific libraries were provided, collect all libraries
+        if not libraries:
+            for lib in needed:
+                all_libs[lib].append((path, arch))
+        else:
+            for lib in libraries:
+                if lib in needed:
+                    log(VERBOSE, f"Found match: {lib} in {path}")
+                    usage[lib].append((path, arch))
 
     return all_libs if not libraries else usage
 
 
-def write_txt_report(output, data):
-    """Write a text report sorted by usage count."""
-    with open(output, 'w', encoding='utf-8') as f:
+def version_label(version):
+    """Format a (version, file) requirement as 'VERSION@file'."""
+    return None if version is None else f'{version[0]}@{version[1]}'
+
+
+def scan_symbols(root, symbols, libraries, arch_filter, resolver,
+                 transitive=False, **walk):
+    """
+    Scan root for executables importing any of symbols.
+
+    Returns {symbol: (importers, exporters)}, where importers is a list of
+    (path, arch, version) and exporters the set of resolved libraries of
+    those importers that define the symbol. With libraries, only
+    executables depending on one of them are considered, and only those
+    libraries are reported as exporters.
+    """
+    result = {sym: ([], set()) for sym in symbols}
+    log_scan_parameters(root, libraries, arch_filter, resolver)
+    log(NORMAL, f"Looking for symbols: {symbols}")
+    if not os.path.isdir(root):
+        log(NORMAL, "Exporters are not resolved inside archives; extract it "
+                    "and use --sysroot to get them")
+
+    for path, arch, needed, info in iter_executables(
+            root, arch_filter, resolver if transitive else None,
+            symbols=set(symbols), **walk):
+        if not info.imports:
+            continue
+        if libraries and not any(lib in needed for lib in libraries):
+            continue
+
+        # Archive members cannot be resolved against the host filesystem
+        deps = []
+        if os.path.isdir(root):
+            deps = resolver.dependency_paths(path, info, transitive)
+        if libraries:
+            deps = [d for d in deps
+                    if os.path.basename(d) in libraries
+                    or resolver.info(d).soname in libraries]
+
+        # All queried names at once, so each library is parsed only once
+        defined = {d: resolver.exports(d, symbols) for d in deps}
+        for sym, version in info.imports.items():
+            log(VERBOSE, f"Imports {sym} ({version_label(version)})")
+            importers, exporters = result[sym]
+            importers.append((path, arch, version))
+            exporters.update(d for d in deps if sym in defined[d])
+
+    return result
+
+
+def write_symbol_report(output, data):
+    """Write a text report of importers and exporters per symbol."""
+    with open_output(output) as f:
+        f.write('bldd Symbol Report\n')
+        f.write('==================\n\n')
+        timestamp = datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+        f.write(f'Generated on: {timestamp}\n\n')
+
+        for sym, (importers, exporters) in data:
+            f.write(f'Symbol: {sym}\n')
+            f.write(f'Total importers: {len(importers)}\n')
+            f.write('Exported by:\n')
+            for lib in sorted(exporters):
+                f.write(f'  - {lib}\n')
+            if not exporters:
+                f.write('  (no resolved library defines it)\n')
+            f.write('Imported by:\n')
+            for path, arch, version in importers:
+                label = version_label(version)
+                suffix = f' [{label}]' if label else ''
+                f.write(f'  - {path} ({arch}){suffix}\n')
+            f.write('\n')
+
+    log(NORMAL, f'Symbol report saved to {output}')
+
+
+def stream_records(root, libraries, arch_filter, resolver=None, **walk):
+    """
+    Yield one record per matching executable without aggregating results.
+
+    With libraries, only executables depending on at least one of them
+    are yielded and 'libs' lists the matches; otherwise 'libs' lists all
+    dependencies.
+    """
+    log_scan_parameters(root, libraries, arch_filter, resolver)
+    for path, arch, needed, info in iter_executables(
+            root, arch_filter, resolver, **walk):
+        if libraries:
+            libs = [lib for lib in libraries if lib in needed]
+            if not libs:
+                continue
+        else:
+            libs = needed
+        record = {'path': path, 'arch': arch, 'libs': libs}
+        if walk.get('symbols'):
+            if not info.imports:
+                continue
+            record['symbols'] = {
+                name: version_label(version)
+                for name, version in info.imports.items()
+            }
+        yield record
+
+
+def open_output(output):
+    """Open the report destination, '-' meaning stdout."""
+    if output == '-':
+        return contextlib.nullcontext(sys.stdout)
+    return open(output, 'w', encoding='utf-8', newline='')
+
+
+def write_ndjson_stream(output, records):
+    """Write one JSON object per line as records arrive."""
+    count = 0
+    with open_output(output) as f:
+        for record in records:
+            f.write(json.dumps(record) + '\n')
+            f.flush()
+            count += 1
+    log(NORMAL, f'NDJSON report with {count} records saved to {output}')
+
+
+def write_csv_stream(output, records):
+    """Write one CSV row per executable as records arrive."""
+    count = 0
+    with open_output(output) as f:
+        writer = csv.writer(f)
+        writer.writerow(['path', 'arch', 'libs', 'symbols'])
+        for record in records:
+            symbols = ';'.join(
+                f'{name}:{version}' if version else name
+                for name, version in record.get('symbols', {}).items()
+            )
+            writer.writerow(
+                [record['path'], record['arch'], ';'.join(record['libs']),
+                 symbols]
+            )
+            f.flush()
+            count += 1
+    log(NORMAL, f'CSV report with {count} records saved to {output}')
+
+
+def report_totals(data):
+    """Return (libraries, executables) counted over the whole result set."""
+    return len(data), sum(len(paths) for _, paths in data)
+
+
+def write_txt_report(output, data, summary_only=False, top=None):
+    """
+    Write a text report sorted by usage count.
+
+    With summary_only, only the usage count of each library is listed;
+    with top, only the top most used libraries are reported.
+    """
+    total_libs, total_executables = report_totals(data)
+    shown = data[:top] if top else data
+
+    with open_output(output) as f:
         f.write('bldd Report\n')
         f.write('===========\n\n')
         timestamp = datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S")
         f.write(f'Generated on: {timestamp}\n\n')
 
         # Summary section
-        total_libs = len(data)
-        total_executables = sum(len(paths) for _, paths in data)
         f.write('Summary:\n')
         f.write(f'Total libraries found: {total_libs}\n')
-        f.write(f'Total executables analyzed: {total_executables}\n\n')
+        f.write(f'Total executables analyzed: {total_executables}\n')
+        if len(shown) < total_libs:
+            f.write(f'Showing the top {len(shown)} libraries\n')
+        f.write('\n')
 
-        f.write('Detailed Report:\n')
-        f.write('--------------\n\n')
+        if summary_only:
+            f.write('Library Usage:\n')
+            f.write('--------------\n\n')
+            width = max((len(str(len(paths))) for _, paths in shown),
+                        default=1)
+            for lib, paths in shown:
+                f.write(f'  {len(paths):>{width}}  {lib}\n')
+        else:
+            f.write('Detailed Report:\n')
+            f.write('--------------\n\n')
 
-        for lib, paths in data:
-            f.write(f'Library: {lib}\n')
-            f.write(f'Total usages: {len(paths)}\n')
-            f.write('Executables:\n')
-            for p in paths:
-                try:
-                    arch = get_file_arch(p)
-                    arch_name = next(
-                        (k for k, v in ARCH_MAP.items() if v == arch),
-                        arch
-                    )
-                    f.write(f'  - {p} ({arch_name})\n')
-                except Exception:
-                    f.write(f'  - {p} (architecture unknown)\n')
-            f.write('\n')
+            for lib, paths in shown:
+                f.write(f'Library: {lib}\n')
+                f.write(f'Total usages: {len(paths)}\n')
+                f.write('Executables:\n')
+                f.writelines(f'  - {p} ({arch})\n' for p, arch in paths)
+                f.write('\n')
 
-    print(f'Text report saved to {output}')
+    log(NORMAL, f'Text report saved to {output}')
 
 
-def write_pdf_report(output, data):
-    """Write a PDF report using ReportLab."""
-    if not PDF_SUPPORTED:
-        print(
-            "Error: reportlab is required for PDF output. "
-            "Install with 'pip install reportlab'."
-        )
-        sys.exit(1)
+def fit_text(text, width):
+    """Shorten text in the middle so it fits width points in a PDF cell."""
+    font, size = PDF_TABLE_FONT
+    if stringWidth(text, font, size) <= width:
+        return text
+    # Keep the end of a path, which names the file
+    keep = int(len(text) * width / stringWidth(text, font, size)) - 1
+    head = keep // 3
+    return text[:head] + '\u2026' + text[len(text) - (keep - head):]
 
-    doc = SimpleDocTemplate(output)
+
+def pdf_tables(header, rows, col_widths):
+    """
+    Yield rows as Table flowables of at most PDF_TABLE_ROWS rows each.
+
+    Cells are plain strings, which ReportLab draws directly; a Paragraph
+    per cell is what made large reports slow.
+    """
+    font, size = PDF_TABLE_FONT
+    style = TableStyle([
+        ('FONT', (0, 0), (-1, -1), font, size),
+        ('FONT', (0, 0), (-1, 0), font + '-Bold', size),
+        ('LINEBELOW', (0, 0), (-1, 0), 0.5, colors.grey),
+        ('TOPPADDING', (0, 0), (-1, -1), 1),
+        ('BOTTOMPADDING', (0, 0), (-1, -1), 1),
+    ])
+    chunk = [header]
+    for row in rows:
+        chunk.append(row)
+        if len(chunk) > PDF_TABLE_ROWS:
+            yield Table(chunk, colWidths=col_widths, style=style,
+                        repeatRows=1)
+            chunk = [header]
+    if len(chunk) > 1:
+        yield Table(chunk, colWidths=col_widths, style=style, repeatRows=1)
+
+
+def pdf_report_flowables(doc, data, summary_only, top):
+    """Yield the flowables of a PDF report one section at a time."""
     styles = getSampleStyleSheet()
-    elems = []
+    total_libs, total_executables = report_totals(data)
+    shown = data[:top] if top else data
 
     # Title and timestamp
-    elems.append(Paragraph('bldd Report', styles['Title']))
+    yield Paragraph('bldd Report', styles['Title'])
     timestamp = datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S")
-    elems.append(Paragraph(
-        f'Generated on: {timestamp}',
-        styles['Normal']
-    ))
-    elems.append(Spacer(1, 12))
+    yield Paragraph(f'Generated on: {timestamp}', styles['Normal'])
+    yield Spacer(1, 12)
 
     # Summary section
-    total_libs = len(data)
-    total_executables = sum(len(paths) for _, paths in data)
-    elems.append(Paragraph('Summary', styles['Heading1']))
-    elems.append(Paragraph(
-        f'Total libraries found: {total_libs}',
-        styles['Normal']
-    ))
-    elems.append(Paragraph(
+    yield Paragraph('Summary', styles['Heading1'])
+    yield Paragraph(f'Total libraries found: {total_libs}', styles['Normal'])
+    yield Paragraph(
         f'Total executables analyzed: {total_executables}',
         styles['Normal']
-    ))
-    elems.append(Spacer(1, 12))
+    )
+    if len(shown) < total_libs:
+        yield Paragraph(
+            f'Showing the top {len(shown)} libraries',
+            styles['Normal']
+        )
+    yield Spacer(1, 12)
+
+    narrow = 50
+    wide = doc.width - narrow
+    if summary_only:
+        yield Paragraph('Library Usage', styles['Heading1'])
+        yield from pdf_tables(
+            ('Library', 'Usages'),
+            ((fit_text(lib, wide), len(paths)) for lib, paths in shown),
+            (wide, narrow)
+        )
+        return
 
     # Detailed report
-    elems.append(Paragraph('Detailed Report', styles['Heading1']))
-    elems.append(Spacer(1, 12))
-
-    for lib, paths in data:
-        elems.append(Paragraph(
-            f'{lib} - {len(paths)} usages',
-            styles['Heading2']
-        ))
-        for p in paths:
-            try:
-                arch = get_file_arch(p)
-                arch_name = next(
-                    (k for k, v in ARCH_MAP.items() if v == arch),
-                    arch
-                )
-                elems.append(Paragraph(
-                    f'{p} ({arch_name})',
-                    styles['Normal']
-                ))
-            except Exception:
-                elems.append(Paragraph(
-                    f'{p} (architecture unknown)',
-                    styles['Normal']
-                ))
-        elems.append(Spacer(1, 12))
+    yield Paragraph('Detailed Report', styles['Heading1'])
+    yield Spacer(1, 12)
+
+    for lib, paths in shown:
+        yield Paragraph(f'{lib} - {len(paths)} usages', styles['Heading2'])
+        yield from pdf_tables(
+            ('Executable', 'Arch'),
+            ((fit_text(p, wide), arch) for p, arch in paths),
+            (wide, narrow)
+        )
+        yield Spacer(1, 12)
+
+
+class LazyFlowables(list):
+    """
+    Flowable list for doc.build() that is filled from an iterator.
+
+    ReportLab consumes the list from the front, so only a few tables exist
+    at any time instead of one per page of the whole report.
+    """
+
+    def __init__(self, flowables, ahead=8):
+        super().__init__()
+        self._source = iter(flowables)
+        self._ahead = ahead
+        self._fill()
+
+    def _fill(self):
+        while list.__len__(self) < self._ahead:
+            flowable = next(self._source, None)
+            if flowable is None:
+                self._ahead = 0
+                break
+            self.append(flowable)
 
-    doc.build(elems)
-    print(f'PDF report saved to {output}')
+    def __len__(self):
+        self._fill()
+        return list.__len__(self)
+
+    def __delitem__(self, index):
+        list.__delitem__(self, index)
+        self._fill()
+
+
+def write_pdf_report(output, data, summary_only=False, top=None):
+    """
+    Write a PDF report using ReportLab.
+
+    Each library section is a series of page-sized tables built from the
+    collected (path, arch) pairs; summary_only and top work as for
+    write_txt_report().
+    """
+    if not PDF_SUPPORTED:
+        print(
+            "Error: reportlab is required for PDF output. "
+            "Install with 'pip install reportlab'."
+        )
+        sys.exit(1)
+
+    doc = SimpleDocTemplate(output)
+    doc.build(LazyFlowables(
+        pdf_report_flowables(doc, data, summary_only, top)
+    ))
+    log(NORMAL, f'PDF report saved to {output}')
 
 
 def main():
@@ -252,6 +1521,22 @@ def main():
 
             # Filter to x86_64 executables only
             bldd.py -d ./build -l libcrypto.so.1.1 -a x86_64
+
+            # Scan the whole system without pseudo and network filesystems
+            bldd.py -d / -x -e /proc -e /sys -e /home -l libssl.so.3
+
+            # Which executables import a vulnerable function, and from where
+            bldd.py -d /usr/bin -s EVP_DecryptUpdate -l libcrypto.so.3
+
+            # Scan an initramfs or container image without extracting it
+            bldd.py -d initramfs.cpio.gz -a armv7
+            bldd.py -d image.tar -l libssl.so.3 -f ndjson -o -
+
+            # Stream one JSON record per executable to another tool
+            bldd.py -d /usr -l libssl.so.3 -f ndjson -o - -q | jq .path
+
+            # Also count executables reaching libcrypto through libssl
+            bldd.py -d /usr/bin -l libcrypto.so.3 --transitive
         ''')
     )
 
@@ -259,7 +1544,11 @@ def main():
         '-d', '--dir',
         required=True,
         metavar='DIR',
-        help='Root directory to scan for ELF executables'
+        help=(
+            'Root directory to scan for ELF executables, or a tar,\n'
+            'tar.gz/xz/bz2/zst, newc cpio(.gz) or container image\n'
+            'archive to scan in memory'
+        )
     )
     parser.add_argument(
         '-l', '--libs',
@@ -279,21 +1568,168 @@ def main():
     )
     parser.add_argument(
         '-o', '--output',
-        default='bldd_report.txt',
         metavar='FILE',
-        help='Path to save the report (default: bldd_report.txt)'
+        help=(
+            'Path to save the report, - for stdout\n'
+            '(default: bldd_report.FMT)'
+        )
     )
     parser.add_argument(
         '-f', '--format',
-        choices=['txt', 'pdf'],
+        choices=['txt', 'pdf'] + list(STREAM_FORMATS),
         default='txt',
         metavar='FMT',
-        help='Report format (txt or pdf, default: txt)'
+        help=(
+            'Report format (default: txt). txt and pdf are sorted by\n'
+            'usage; ndjson and csv stream one record per executable'
+        )
+    )
+    parser.add_argument(
+        '--summary',
+        action='store_true',
+        help=(
+            'txt and pdf: list only the usage count of each library,\n'
+            'not the executables'
+        )
+    )
+    parser.add_argument(
+        '--top',
+        type=int,
+        metavar='N',
+        help='txt and pdf: report only the N most used libraries'
+    )
+    parser.add_argument(
+        '-s', '--symbols',
+        nargs='+',
+        metavar='SYM',
+        help=(
+            'Report executables importing these dynamic symbols and the\n'
+            'libraries exporting them (combine with -l to restrict)'
+        )
+    )
+    parser.add_argument(
+        '-e', '--exclude',
+        action='append',
+        default=[],
+        metavar='GLOB',
+        help=(
+            'Skip files and directories matching GLOB (repeatable).\n'
+            'Patterns with a / match the full path, e.g. /proc'
+        )
+    )
+    parser.add_argument(
+        '-x', '--one-file-system',
+        action='store_true',
+        help='Do not descend into directories on other filesystems'
+    )
+    parser.add_argument(
+        '-j', '--jobs',
+        type=int,
+        default=1,
+        metavar='N',
+        help=(
+            'Parse files in N worker processes (default: 1, 0 = one per\n'
+            'CPU). Archives are always read sequentially'
+        )
+    )
+    verbosity = parser.add_mutually_exclusive_group()
+    verbosity.add_argument(
+        '-q', '--quiet',
+        action='store_const',
+        dest='verbosity',
+        const=QUIET,
+        default=NORMAL,
+        help='Only print errors'
+    )
+    verbosity.add_argument(
+        '-v', '--verbose',
+        action='store_const',
+        dest='verbosity',
+        const=VERBOSE,
+        help='Print per-file diagnostics'
+    )
+
+    parser.add_argument(
+        '-t', '--transitive',
+        action='store_true',
+        help=(
+            'Match against the full dependency closure, resolving each\n'
+            'DT_NEEDED via RPATH/RUNPATH, ld.so.cache and default paths'
+        )
+    )
+    parser.add_argument(
+        '--sysroot',
+        default='/',
+        metavar='DIR',
+        help=(
+            'Root of the scanned system used to resolve library paths\n'
+            'in --transitive mode (default: /)'
+        )
     )
 
     args = parser.parse_args()
 
-    usage = scan_directory(args.dir, args.libs, args.arch)
+    global VERBOSITY, LOG_STREAM
+    VERBOSITY = args.verbosity
+    if args.output is None:
+        args.output = f'bldd_report.{args.format}'
+    if args.output == '-':
+        if args.format == 'pdf':
+            parser.error('PDF reports cannot be written to stdout')
+        LOG_STREAM = sys.stderr
+
+    if (args.summary or args.top) and (args.format in STREAM_FORMATS
+                                       or args.symbols):
+        parser.error('--summary and --top apply to txt and pdf '
+                     'library reports')
+    if args.top is not None and args.top < 1:
+        parser.error('--top must be at least 1')
+
+    if not os.path.isdir(args.dir):
+        try:
+            archive = is_archive(args.dir)
+        except OSError as e:
+            parser.error(f'cannot read {args.dir}: {e.strerror}')
+        if not archive:
+            parser.error(f'{args.dir} is neither a directory nor a tar, '
+                         'cpio or container image archive')
+    if args.transitive and not os.path.isdir(args.dir):
+        parser.error('--transitive needs a directory, not an archive '
+                     '(extract it and use --sysroot)')
+
+    resolver = LibraryResolver(args.sysroot) if args.transitive else None
+    walk = {
+        'excludes': args.exclude,
+        'one_file_system': args.one_file_system,
+        'jobs': args.jobs if args.jobs > 0 else os.cpu_count(),
+    }
+    if args.symbols and args.format in STREAM_FORMATS:
+        walk['symbols'] = set(args.symbols)
+    elif args.symbols:
+        if args.format == 'pdf':
+            parser.error('symbol reports are available as txt, ndjson or csv')
+        result = scan_symbols(
+            args.dir, args.symbols, args.libs, args.arch,
+            resolver or LibraryResolver(args.sysroot),
+            transitive=args.transitive, **walk
+        )
+        write_symbol_report(
+            args.output,
+            sorted(result.items(), key=lambda item: len(item[1][0]),
+                   reverse=True)
+        )
+        return
+
+    if args.format in STREAM_FORMATS:
+        records = stream_records(args.dir, args.libs, args.arch, resolver,
+                                 **walk)
+        if args.format == 'ndjson':
+            write_ndjson_stream(args.output, records)
+        else:
+            write_csv_stream(args.output, records)
+        return
+
+    usage = scan_directory(args.dir, args.libs, args.arch, resolver, **walk)
     sorted_usage = sorted(
         usage.items(),
         key=lambda item: len(item[1]),
@@ -301,9 +1737,9 @@ def main():
     )
 
     if args.format == 'pdf':
-        write_pdf_report(args.output, sorted_usage)
+        write_pdf_report(args.output, sorted_usage, args.summary, args.top)
     else:
-        write_txt_report(args.output, sorted_usage)
+        write_txt_report(args.output, sorted_usage, args.summary, args.top)
 
 
 if __name__ == '__main__':
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+bldd benchmark runner
+
+Generates synthetic corpora of increasing size with gen_corpus.py (cached
+between runs), scans each with bldd at several job counts and reports
+files/s and peak RSS as JSON lines, one per (size, jobs) point:
+
+  {"executables": 4000, "files": 4856, "jobs": 4, "wall_s": 1.92,
+   "files_per_s": 2529.2, "peak_rss_kb": 41232, ...}
+
+Each point is the median of --repeat runs. Peak RSS is the largest
+resident set of bldd or any of its workers, taken from wait4().
+"""
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BLDD = os.path.join(HERE, '..', 'src', 'bldd.py')
+GEN_CORPUS = os.path.join(HERE, 'gen_corpus.py')
+
+
+def corpus_path(cache, executables, args):
+    """Return the cache directory for one corpus configuration."""
+    name = (f'n{executables}-L{args.libs}-F{args.fanout}-s{args.size}'
+            f'-noise{args.noise}-seed{args.seed}')
+    return os.path.join(cache, name)
+
+
+def ensure_corpus(path, executables, args):
+    """Generate the corpus unless a previous run already did."""
+    stamp = path + '.complete'
+    if os.path.exists(stamp):
+        return
+    if os.path.exists(path):
+        subprocess.run(['rm', '-rf', path], check=True)
+    subprocess.run([
+        sys.executable, GEN_CORPUS, '-o', path,
+        '-n', str(executables), '-L', str(args.libs),
+        '-F', str(args.fanout), '-s', str(args.size),
+        '--noise', str(args.noise * executables // 100),
+        '--symlinks', str(executables // 20),
+        '--hardlinks', str(executables // 20),
+        '--seed', str(args.seed),
+    ], check=True, stdout=subprocess.DEVNULL)
+    open(stamp, 'w').close()
+
+
+def count_files(path):
+    """Count directory entries bldd has to look at."""
+    return sum(len(files) for _, _, files in os.walk(path))
+
+
+def run_once(path, jobs, extra):
+    """Run one scan; return (wall seconds, peak RSS in KiB, records)."""
+    cmd = [sys.executable, BLDD, '-d', path, '-f', 'ndjson', '-o', '-',
+           '-q', '-j', str(jobs)] + extra
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE)
+    records = sum(1 for _ in proc.stdout)
+    _, status, rusage = os.wait4(proc.pid, 0)
+    wall = time.perf_counter() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        raise RuntimeError(f'{" ".join(cmd)} exited with {proc.returncode}')
+    # ru_maxrss covers the process and its waited-for workers
+    return wall, rusage.ru_maxrss, records
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark bldd scans')
+    parser.add_argument('--sizes', type=int, nargs='+',
+                        default=[250, 1000, 4000], metavar='N',
+                        help='Executables per architecture for each corpus '
+                        '(default: 250 1000 4000)')
+    parser.add_argument('--jobs', type=int, nargs='+', default=[1, 2, 4],
+                        metavar='J', help='bldd -j values (default: 1 2 4)')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='Runs per point; the median is reported '
+                        '(default: 3)')
+    parser.add_argument('--cache', default='/tmp/bldd-bench', metavar='DIR',
+                        help='Where corpora are generated and kept '
+                        '(default: /tmp/bldd-bench)')
+    parser.add_argument('-o', '--output', default='-', metavar='FILE',
+                        help='JSON lines output (default: stdout)')
+    parser.add_argument('--libs', type=int, default=50,
+                        help='Libraries per architecture (default: 50)')
+    parser.add_argument('--fanout', type=int, default=4,
+                        help='DT_NEEDED per object (default: 4)')
+    parser.add_argument('--size', type=int, default=16384,
+                        help='Executable size in bytes (default: 16384)')
+    parser.add_argument('--noise', type=int, default=20, metavar='PCT',
+                        help='Non-ELF files as a percentage of executables '
+                        '(default: 20)')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('bldd_args', nargs='*', metavar='-- ARG',
+                        help='Extra bldd arguments, e.g. -- --transitive')
+    args = parser.parse_args()
+
+    out = sys.stdout if args.output == '-' else open(args.output, 'w')
+    with out:
+        for executables in args.sizes:
+            path = corpus_path(args.cache, executables, args)
+            ensure_corpus(path, executables, args)
+            files = count_files(path)
+
+            for jobs in args.jobs:
+                runs = [run_once(path, jobs, args.bldd_args)
+                        for _ in range(args.repeat)]
+                wall = statistics.median(r[0] for r in runs)
+                result = {
+                    'executables': executables,
+                    'files': files,
+                    'records': runs[0][2],
+                    'jobs': jobs,
+                    'args': args.bldd_args,
+                    'wall_s': round(wall, 3),
+                    'files_per_s': round(files / wall, 1),
+                    'peak_rss_kb': max(r[1] for r in runs),
+                }
+                out.write(json.dumps(result) + '\n')
+                out.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,434 @@
+#!/usr/bin/env python3
+"""
+Synthetic ELF corpus generator for bldd
+
+Fabricates a directory tree of minimal but valid dynamically linked ELF
+files for x86, x86_64, armv7 and aarch64 without any cross toolchain.
+Each architecture gets its own set of shared libraries (with DT_SONAME,
+DT_NEEDED between libraries and a DT_GNU_HASH export table) and a number
+of executables that need some of them and import their symbols, half of
+them with a .gnu.version_r requirement. Non-ELF
+noise files, symlinks and hardlinks can be mixed in to exercise the
+traversal.
+
+Executables carry a DT_RUNPATH of $ORIGIN/... pointing at their libraries,
+so 'bldd --transitive' resolves the whole corpus without a sysroot.
+"""
+
+import argparse
+import os
+import random
+import struct
+import sys
+
+# name: (e_machine, ELF class, e_flags, multiarch directory, ET_EXEC base)
+ARCHES = {
+    'x86':     (3,   32, 0,          'i386-linux-gnu',      0x08048000),
+    'x86_64':  (62,  64, 0,          'x86_64-linux-gnu',    0x00400000),
+    # EABI5, hard-float
+    'armv7':   (40,  32, 0x05000400, 'arm-linux-gnueabihf', 0x00010000),
+    'aarch64': (183, 64, 0,          'aarch64-linux-gnu',   0x00400000),
+}
+
+ET_EXEC, ET_DYN = 2, 3
+PT_LOAD, PT_DYNAMIC = 1, 2
+PF_R = 4
+SHT_STRTAB, SHT_DYNAMIC, SHT_DYNSYM, SHT_GNU_HASH = 3, 6, 11, 0x6ffffff6
+SHT_GNU_VERNEED, SHT_GNU_VERSYM = 0x6ffffffe, 0x6fffffff
+SHF_ALLOC = 2
+DT_NULL, DT_NEEDED, DT_STRTAB, DT_SYMTAB, DT_STRSZ, DT_SYMENT = 0, 1, 5, 6, 10, 11
+DT_SONAME, DT_RUNPATH, DT_GNU_HASH = 14, 29, 0x6ffffef5
+DT_VERSYM, DT_VERNEED, DT_VERNEEDNUM = 0x6ffffff0, 0x6ffffffe, 0x6fffffff
+VER_NDX_GLOBAL = 1
+STB_GLOBAL, STT_FUNC = 1, 2
+
+SYMBOLS_PER_LIB = 16
+
+
+class Layout:
+    """Struct formats and sizes for one ELF class."""
+
+    def __init__(self, elfclass):
+        self.is64 = elfclass == 64
+        self.ehdr = '<16sHHIQQQIHHHHHH' if self.is64 else '<16sHHIIIIIHHHHHH'
+        self.phdr = '<IIQQQQQQ' if self.is64 else '<IIIIIIII'
+        self.shdr = '<IIQQQQIIQQ' if self.is64 else '<IIIIIIIIII'
+        self.dyn = '<qQ' if self.is64 else '<iI'
+        self.sym = '<IBBHQQ' if self.is64 else '<IIIBBH'
+        self.word = 8 if self.is64 else 4
+
+    def size(self, fmt):
+        return struct.calcsize(fmt)
+
+    def pack_sym(self, name, value, shndx):
+        info = (STB_GLOBAL << 4) | STT_FUNC
+        if self.is64:
+            return struct.pack(self.sym, name, info, 0, shndx, value, 0)
+        return struct.pack(self.sym, name, value, 0, info, 0, shndx)
+
+    def pack_phdr(self, p_type, offset, vaddr, filesz):
+        if self.is64:
+            return struct.pack(self.phdr, p_type, PF_R, offset, vaddr, vaddr,
+                               filesz, filesz, 8)
+        return struct.pack(self.phdr, p_type, offset, vaddr, vaddr,
+                           filesz, filesz, PF_R, 4)
+
+
+def gnu_hash(name):
+    h = 5381
+    for c in name.encode():
+        h = (h * 33 + c) & 0xffffffff
+    return h
+
+
+def elf_hash(name):
+    h = 0
+    for c in name.encode():
+        h = ((h << 4) + c) & 0xffffffff
+        h ^= (h >> 24) & 0xf0
+    return h & 0x0fffffff
+
+
+def build_verneed(versions, add_str):
+    """
+    Return ({(version, file): versym index}, .gnu.version_r bytes, number
+    of Verneed entries) for the distinct requirements in versions.
+    """
+    by_file = {}
+    for req in versions:
+        if req is not None:
+            by_file.setdefault(req[1], [])
+            if req[0] not in by_file[req[1]]:
+                by_file[req[1]].append(req[0])
+
+    # Verneed and Vernaux are 16 bytes in both ELF classes
+    index, data, ndx = {}, b'', VER_NDX_GLOBAL + 1
+    for n, (file, names) in enumerate(by_file.items()):
+        last = n + 1 == len(by_file)
+        data += struct.pack('<HHIII', 1, len(names), add_str(file), 16,
+                            0 if last else 16 + 16 * len(names))
+        for k, name in enumerate(names):
+            index[(name, file)] = ndx
+            data += struct.pack('<IHHII', elf_hash(name), 0, ndx,
+                                add_str(name), 0 if k + 1 == len(names) else 16)
+            ndx += 1
+    return index, data, len(by_file)
+
+
+def build_gnu_hash(layout, names, symoffset):
+    """
+    Return (sorted names, .gnu.hash bytes). The exported symbols must be
+    ordered by bucket in .dynsym, so the caller uses the returned order.
+    """
+    nbuckets = max(1, len(names) // 4)
+    bloom_shift = 6
+    bits = layout.word * 8
+    names = sorted(names, key=lambda n: gnu_hash(n) % nbuckets)
+    hashes = [gnu_hash(n) for n in names]
+
+    bloom = 0
+    for h in hashes:
+        bloom |= (1 << (h % bits)) | (1 << ((h >> bloom_shift) % bits))
+
+    buckets = [0] * nbuckets
+    chains = []
+    for i, h in enumerate(hashes):
+        b = h % nbuckets
+        if buckets[b] == 0:
+            buckets[b] = symoffset + i
+        last = i + 1 == len(hashes) or hashes[i + 1] % nbuckets != b
+        chains.append((h & ~1) | (1 if last else 0))
+
+    data = struct.pack('<IIII', nbuckets, symoffset, 1, bloom_shift)
+    data += struct.pack('<Q' if layout.is64 else '<I', bloom)
+    data += struct.pack(f'<{nbuckets}I', *buckets)
+    data += struct.pack(f'<{len(chains)}I', *chains)
+    return names, data
+
+
+def make_elf(arch, e_type, needed=(), soname=None, runpath=None,
+             imports=(), versions=(), exports=(), size=0):
+    """
+    Return the bytes of a minimal dynamically linked ELF object.
+
+    versions holds a (version, file) requirement or None per import.
+
+    Layout: ELF header, PT_LOAD + PT_DYNAMIC program headers, .dynstr,
+    .dynsym, .gnu.hash (if exporting), .gnu.version and .gnu.version_r (if
+    any import is versioned), .dynamic, zero padding up to size, .shstrtab
+    and the section headers at the end, like a linked binary.
+    """
+    machine, elfclass, flags, _, exec_base = ARCHES[arch]
+    lay = Layout(elfclass)
+    base = exec_base if e_type == ET_EXEC else 0
+
+    dynstr = bytearray(b'\0')
+
+    def add_str(s):
+        off = len(dynstr)
+        dynstr.extend(s.encode() + b'\0')
+        return off
+
+    needed_off = [add_str(n) for n in needed]
+    soname_off = add_str(soname) if soname else None
+    runpath_off = add_str(runpath) if runpath else None
+    version_index, verneed_data, verneed_num = build_verneed(versions, add_str)
+
+    gnu_hash_data = b''
+    if exports:
+        exports, gnu_hash_data = build_gnu_hash(
+            lay, list(exports), 1 + len(imports)
+        )
+
+    ehsize = lay.size(lay.ehdr)
+    phentsize = lay.size(lay.phdr)
+    off = ehsize + 2 * phentsize
+
+    dynstr_off = off
+    sym_names = [add_str(n) for n in list(imports) + list(exports)]
+    off += len(dynstr)
+    off = (off + 7) & ~7
+
+    syment = lay.size(lay.sym)
+    dynsym_off = off
+    # Defined symbols point at .dynamic (index 4); any allocated section works
+    dynsym = b'\0' * syment
+    for i, name_off in enumerate(sym_names):
+        defined = i >= len(imports)
+        dynsym += lay.pack_sym(name_off, base + 0x1000 + i if defined else 0,
+                               4 if defined else 0)
+    off += len(dynsym)
+    off = (off + 7) & ~7
+
+    gnu_hash_off = off
+    off += len(gnu_hash_data)
+    off = (off + 7) & ~7
+
+    versym_data = b''
+    if verneed_data:
+        ndx = [0] + [version_index.get(v, VER_NDX_GLOBAL) for v in versions]
+        ndx += [VER_NDX_GLOBAL] * len(exports)
+        versym_data = struct.pack(f'<{len(ndx)}H', *ndx)
+    versym_off = off
+    off += len(versym_data)
+    off = (off + 7) & ~7
+    verneed_off = off
+    off += len(verneed_data)
+    off = (off + 7) & ~7
+
+    dyn_entries = [(DT_NEEDED, o) for o in needed_off]
+    if soname_off is not None:
+        dyn_entries.append((DT_SONAME, soname_off))
+    if runpath_off is not None:
+        dyn_entries.append((DT_RUNPATH, runpath_off))
+    dyn_entries += [
+        (DT_STRTAB, base + dynstr_off),
+        (DT_STRSZ, len(dynstr)),
+        (DT_SYMTAB, base + dynsym_off),
+        (DT_SYMENT, syment),
+    ]
+    if gnu_hash_data:
+        dyn_entries.append((DT_GNU_HASH, base + gnu_hash_off))
+    if verneed_data:
+        dyn_entries += [
+            (DT_VERSYM, base + versym_off),
+            (DT_VERNEED, base + verneed_off),
+            (DT_VERNEEDNUM, verneed_num),
+        ]
+    dyn_entries.append((DT_NULL, 0))
+    dynamic = b''.join(struct.pack(lay.dyn, t, v) for t, v in dyn_entries)
+    dynamic_off = off
+    off += len(dynamic)
+
+    load_end = off
+    shstrtab = (b'\0.dynstr\0.dynsym\0.gnu.hash\0.dynamic\0.shstrtab\0'
+                b'.gnu.version\0.gnu.version_r\0')
+    shstrtab_off = max(off, size - len(shstrtab) - 8 - 8 * lay.size(lay.shdr))
+    shoff = (shstrtab_off + len(shstrtab) + 7) & ~7
+
+    def shdr(name, sh_type, offset, length, link=0, entsize=0, addr=True,
+             info=0):
+        return struct.pack(lay.shdr, name, sh_type, SHF_ALLOC if addr else 0,
+                           base + offset if addr else 0, offset, length,
+                           link, 1 if sh_type == SHT_DYNSYM else info,
+                           lay.word, entsize)
+
+    sections = [
+        b'\0' * lay.size(lay.shdr),
+        shdr(1, SHT_STRTAB, dynstr_off, len(dynstr)),
+        shdr(9, SHT_DYNSYM, dynsym_off, len(dynsym), 1, syment),
+        shdr(17, SHT_GNU_HASH, gnu_hash_off, len(gnu_hash_data), 2),
+        shdr(27, SHT_DYNAMIC, dynamic_off, len(dynamic), 1,
+             lay.size(lay.dyn)),
+        shdr(36, SHT_STRTAB, shstrtab_off, len(shstrtab), addr=False),
+        shdr(46, SHT_GNU_VERSYM, versym_off, len(versym_data), 2, 2),
+        shdr(59, SHT_GNU_VERNEED, verneed_off, len(verneed_data), 1,
+             info=verneed_num),
+    ]
+    if not gnu_hash_data:
+        # Keep section indices stable; an empty .gnu.hash is not allowed
+        sections[3] = shdr(17, 0, 0, 0, addr=False)
+    if not verneed_data:
+        sections[6] = shdr(46, 0, 0, 0, addr=False)
+        sections[7] = shdr(59, 0, 0, 0, addr=False)
+
+    ident = b'\x7fELF' + bytes([2 if lay.is64 else 1, 1, 1, 0])
+    ident = ident.ljust(16, b'\0')
+    entry = base + 0x1000 if e_type == ET_EXEC else 0
+    ehdr = struct.pack(lay.ehdr, ident, e_type, machine, 1, entry, ehsize,
+                       shoff, flags, ehsize, phentsize, 2,
+                       lay.size(lay.shdr), len(sections), 5)
+
+    out = bytearray(ehdr)
+    out += lay.pack_phdr(PT_LOAD, 0, base, load_end)
+    out += lay.pack_phdr(PT_DYNAMIC, dynamic_off, base + dynamic_off,
+                         len(dynamic))
+    for offset, data in ((dynstr_off, dynstr), (dynsym_off, dynsym),
+                         (gnu_hash_off, gnu_hash_data),
+                         (versym_off, versym_data),
+                         (verneed_off, verneed_data),
+                         (dynamic_off, dynamic), (shstrtab_off, shstrtab)):
+        out += b'\0' * (offset - len(out))
+        out += data
+    out += b'\0' * (shoff - len(out))
+    out += b''.join(sections)
+    return bytes(out)
+
+
+def lib_name(i):
+    return f'libgen{i}.so.1'
+
+
+def lib_symbol(i, j):
+    return f'gen{i}_func{j}'
+
+
+def lib_version(i, j):
+    """Version requirement on symbol j of library i; even ones have one."""
+    return None if j % 2 else (f'GEN{i}_1.0', lib_name(i))
+
+
+def generate(root, arches, executables, libs, fanout, size, noise,
+             symlinks, hardlinks, per_dir, rng):
+    """Write the corpus under root; return a dict of file counts."""
+    counts = dict.fromkeys(
+        ('executables', 'libraries', 'noise', 'symlinks', 'hardlinks'), 0
+    )
+    exe_paths = []
+
+    for arch in arches:
+        triplet = ARCHES[arch][3]
+        libdir = os.path.join(root, 'lib', triplet)
+        os.makedirs(libdir, exist_ok=True)
+
+        # libgen0 plays libc: every object needs it. Library i only needs
+        # libraries j < i, so the dependency graph is a DAG.
+        for i in range(libs):
+            deps = {lib_name(0)} if i else set()
+            deps.update(lib_name(j) for j in rng.sample(
+                range(1, i), min(fanout, max(i - 1, 0))
+            ))
+            data = make_elf(
+                arch, ET_DYN, needed=sorted(deps), soname=lib_name(i),
+                exports=[lib_symbol(i, j) for j in range(SYMBOLS_PER_LIB)],
+                runpath='$ORIGIN',
+            )
+            with open(os.path.join(libdir, lib_name(i)), 'wb') as f:
+                f.write(data)
+            counts['libraries'] += 1
+
+        for n in range(executables):
+            subdir = os.path.join(root, arch, f'd{n // per_dir:04d}')
+            os.makedirs(subdir, exist_ok=True)
+            deps = [0] + rng.sample(range(1, libs), min(fanout, libs - 1))
+            syms = [(i, rng.randrange(SYMBOLS_PER_LIB)) for i in deps]
+            data = make_elf(
+                arch, rng.choice((ET_EXEC, ET_DYN)),
+                needed=[lib_name(i) for i in deps],
+                runpath=f'$ORIGIN/../../lib/{triplet}',
+                imports=[lib_symbol(i, j) for i, j in syms],
+                versions=[lib_version(i, j) for i, j in syms],
+                size=size,
+            )
+            path = os.path.join(subdir, f'exe{n:06d}')
+            with open(path, 'wb') as f:
+                f.write(data)
+            os.chmod(path, 0o755)
+            exe_paths.append(path)
+            counts['executables'] += 1
+
+    noise_dir = os.path.join(root, 'share')
+    for n in range(noise):
+        subdir = os.path.join(noise_dir, f'd{n // per_dir:04d}')
+        os.makedirs(subdir, exist_ok=True)
+        with open(os.path.join(subdir, f'noise{n:06d}'), 'wb') as f:
+            # Text, random binary, or a truncated ELF header
+            kind = n % 3
+            if kind == 0:
+                f.write(b'#!/bin/sh\necho noise\n' * rng.randint(1, 64))
+            elif kind == 1:
+                f.write(rng.randbytes(rng.randint(1, 4096)))
+            else:
+                f.write(b'\x7fELF\x02\x01')
+        counts['noise'] += 1
+
+    link_dir = os.path.join(root, 'links')
+    os.makedirs(link_dir, exist_ok=True)
+    for n in range(min(symlinks, len(exe_paths))):
+        target = rng.choice(exe_paths)
+        os.symlink(os.path.relpath(target, link_dir),
+                   os.path.join(link_dir, f'sym{n:06d}'))
+        counts['symlinks'] += 1
+    for n in range(min(hardlinks, len(exe_paths))):
+        os.link(rng.choice(exe_paths), os.path.join(link_dir, f'hard{n:06d}'))
+        counts['hardlinks'] += 1
+
+    return counts
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Generate a synthetic ELF corpus for bldd benchmarks'
+    )
+    parser.add_argument('-o', '--output', required=True, metavar='DIR',
+                        help='Directory to create the corpus in')
+    parser.add_argument('-n', '--executables', type=int, default=1000,
+                        metavar='N', help='Executables per architecture '
+                        '(default: 1000)')
+    parser.add_argument('-a', '--arch', nargs='+', default=list(ARCHES),
+                        choices=list(ARCHES), metavar='ARCH',
+                        help='Architectures to generate (default: all)')
+    parser.add_argument('-L', '--libs', type=int, default=50, metavar='N',
+                        help='Shared libraries per architecture (default: 50)')
+    parser.add_argument('-F', '--fanout', type=int, default=4, metavar='N',
+                        help='DT_NEEDED entries per object (default: 4)')
+    parser.add_argument('-s', '--size', type=int, default=0, metavar='BYTES',
+                        help='Pad executables to this size (default: minimal)')
+    parser.add_argument('--noise', type=int, default=0, metavar='N',
+                        help='Non-ELF files to add (default: 0)')
+    parser.add_argument('--symlinks', type=int, default=0, metavar='N',
+                        help='Symlinks to executables (default: 0)')
+    parser.add_argument('--hardlinks', type=int, default=0, metavar='N',
+                        help='Hardlinks to executables (default: 0)')
+    parser.add_argument('--per-dir', type=int, default=500, metavar='N',
+                        help='Files per directory (default: 500)')
+    parser.add_argument('--seed', type=int, default=0,
+                        help='Random seed (default: 0)')
+    args = parser.parse_args()
+
+    if args.libs < 1:
+        parser.error('--libs must be at least 1')
+    if os.path.exists(args.output) and os.listdir(args.output):
+        parser.error(f'{args.output} exists and is not empty')
+
+    counts = generate(
+        args.output, args.arch, args.executables, args.libs, args.fanout,
+        args.size, args.noise, args.symlinks, args.hardlinks,
+        args.per_dir, random.Random(args.seed),
+    )
+    print(', '.join(f'{v} {k}' for k, v in counts.items()) +
+          f' written to {args.output}')
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -1,75 +1,1317 @@
 // patcher.c
-// Simple binary patcher: replaces the first MOV EDX,0x21 (BA 21 00 00 00)
-// with MOV EDX,0x00 (BA 00 00 00 00), forcing strncmp(...,0) so it always succeeds.
+// Binary patcher: replaces byte patterns in a binary. By default it replaces
+// the first MOV EDX,0x21 (BA 21 00 00 00) with MOV EDX,0x00 (BA 00 00 00 00),
+// forcing strncmp(...,0) so it always succeeds.
+//
+// Patterns can also be read from a spec file (-p) or given inline (-e):
+//
+//     # old bytes          = new bytes          [@N | @all]
+//     BA 21 00 00 00       = BA 00 00 00 00
+//     74 0A                = EB 0A              @all
+//
+// The input is mapped, not read, and all patterns are matched in a single
+// pass with an Aho-Corasick automaton. The output is a reflink (or an
+// in-kernel copy) of the input, and only the patched bytes are written.
+//
+// For ELF inputs, matching can be limited to named sections (-s .text) or
+// to executable segments (-x), and patches are reported with their virtual
+// address. If the input is a directory, every file in it is patched by a
+// pool of threads and a JSON manifest of the changes is written.
 
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <linux/fs.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <input_binary> <output_binary>\n", argv[0]);
-        return 1;
+// Patch every match instead of the Nth one
+#define OCCURRENCE_ALL 0
+
+// Legacy default: MOV EDX,0x21 -> MOV EDX,0x0
+#define DEFAULT_SPEC "BA 21 00 00 00 = BA 00 00 00 00"
+
+struct pattern {
+    char *text;             // old bytes as written in the spec, for messages
+    uint8_t *old_bytes;
+    uint8_t *new_bytes;
+    size_t len;
+    long occurrence;        // 1-based match to patch, or OCCURRENCE_ALL
+    int next_same_state;    // next pattern ending in the same AC state, or -1
+};
+
+// Per-file match counts of one pattern
+struct pattern_count {
+    size_t seen;            // matches found so far
+    size_t applied;         // matches patched
+    size_t overlapped;      // matches skipped because they overlap a patch
+};
+
+struct pattern_set {
+    struct pattern *v;
+    size_t n, cap;
+};
+
+struct edit {
+    size_t offset;
+    int pattern;
+    int has_vaddr;
+    uint64_t vaddr;         // virtual address, if in a PT_LOAD segment
+    char *section;          // containing section, or NULL
+};
+
+struct edit_list {
+    struct edit *v;
+    size_t n, cap;
+};
+
+// Aho-Corasick automaton, stored as a full DFA: next[s][c] is defined for
+// every state and byte, so scanning is one table lookup per input byte.
+// Edges into states where a pattern ends are stored as ~state (negative),
+// so the scan loop needs no second lookup to know when to report.
+struct automaton {
+    int32_t (*next)[256];
+    int32_t *out;           // first pattern ending in the state, or -1
+    int32_t *dict;          // nearest suffix state with an output, or -1
+    size_t nstates;
+    int first_byte;         // only byte leaving the root, or -1 if several
+    uint8_t starts[256];    // bytes leaving the root
+};
+
+static void *xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (!p) {
+        perror("realloc");
+        exit(1);
     }
+    return p;
+}
 
-    const char *in_path  = argv[1];
-    const char *out_path = argv[2];
-    FILE *fin  = fopen(in_path, "rb");
-    if (!fin) { perror("fopen input"); return 1; }
+// ---------------------------------------------------------------------------
+// Patch specs
+// ---------------------------------------------------------------------------
 
-    // Determine file size
-    fseek(fin, 0, SEEK_END);
-    long fsize = ftell(fin);
-    fseek(fin, 0, SEEK_SET);
+// Parse hex bytes ("BA 21 00", "BA2100") into a new buffer; returns length or -1
+static long parse_hex(const char *s, uint8_t **out)
+{
+    size_t len = 0, cap = 16;
+    uint8_t *buf = xrealloc(NULL, cap);
+    int high = -1;
 
-    // Read entire file into buffer
-    uint8_t *buf = malloc(fsize);
-    if (!buf) { perror("malloc"); fclose(fin); return 1; }
-    if (fread(buf, 1, fsize, fin) != fsize) {
-        perror("fread");
+    for (; *s; s++) {
+        if (isspace((unsigned char)*s))
+            continue;
+        if (!isxdigit((unsigned char)*s)) {
+            free(buf);
+            return -1;
+        }
+        int v = isdigit((unsigned char)*s) ? *s - '0'
+                                           : tolower((unsigned char)*s) - 'a' + 10;
+        if (high < 0) {
+            high = v;
+            continue;
+        }
+        if (len == cap)
+            buf = xrealloc(buf, cap *= 2);
+        buf[len++] = (uint8_t)(high << 4 | v);
+        high = -1;
+    }
+    if (high >= 0 || len == 0) {
         free(buf);
-        fclose(fin);
-        return 1;
+        return -1;
+    }
+    *out = buf;
+    return (long)len;
+}
+
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return s;
+}
+
+// Parse one "OLD = NEW [@N|@all]" line; blank and comment lines are ignored.
+// Returns 0 on success, -1 with a message on error.
+static int add_spec(struct pattern_set *set, const char *line,
+                    long occurrence, const char *where)
+{
+    char *copy = strdup(line);
+    char *s = copy;
+    char *hash = strchr(s, '#');
+    if (hash)
+        *hash = '\0';
+    s = trim(s);
+    if (*s == '\0') {
+        free(copy);
+        return 0;
+    }
+
+    char *eq = strchr(s, '=');
+    if (!eq) {
+        fprintf(stderr, "%s: expected 'OLD = NEW'\n", where);
+        free(copy);
+        return -1;
     }
-    fclose(fin);
+    *eq = '\0';
 
-    // Pattern: BA 21 00 00 00  (MOV EDX,0x21)
-    // Replacement: BA 00 00 00 00 (MOV EDX,0x0)
-    const uint8_t old_pat[5] = {0xBA, 0x21, 0x00, 0x00, 0x00};
-    const uint8_t new_pat[5] = {0xBA, 0x00, 0x00, 0x00, 0x00};
+    char *rhs = eq + 1;
+    char *at = strchr(rhs, '@');
+    if (at) {
+        *at = '\0';
+        char *arg = trim(at + 1), *end;
+        if (strcmp(arg, "all") == 0) {
+            occurrence = OCCURRENCE_ALL;
+        } else {
+            occurrence = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || occurrence < 1) {
+                fprintf(stderr, "%s: bad occurrence '@%s'\n", where, arg);
+                free(copy);
+                return -1;
+            }
+        }
+    }
+
+    struct pattern p = { .occurrence = occurrence, .next_same_state = -1 };
+    long old_len = parse_hex(s, &p.old_bytes);
+    long new_len = parse_hex(rhs, &p.new_bytes);
+    if (old_len < 0 || new_len < 0) {
+        fprintf(stderr, "%s: bad hex bytes\n", where);
+        goto fail;
+    }
+    if (old_len != new_len) {
+        fprintf(stderr, "%s: old and new bytes differ in length (%ld vs %ld)\n",
+                where, old_len, new_len);
+        goto fail;
+    }
+    p.len = (size_t)old_len;
+    p.text = strdup(trim(s));
+
+    if (set->n == set->cap) {
+        set->cap = set->cap ? set->cap * 2 : 8;
+        set->v = xrealloc(set->v, set->cap * sizeof(*set->v));
+    }
+    set->v[set->n++] = p;
+    free(copy);
+    return 0;
 
-    // Find first occurrence
-    long patch_at = -1;
-    for (long i = 0; i <= fsize - 5; i++) {
-        if (memcmp(buf + i, old_pat, 5) == 0) {
-            patch_at = i;
+fail:
+    free(p.old_bytes);
+    free(p.new_bytes);
+    free(copy);
+    return -1;
+}
+
+static int load_spec_file(struct pattern_set *set, const char *path,
+                          long occurrence)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    char *line = NULL, where[512];
+    size_t cap = 0;
+    int lineno = 0, ret = 0;
+    while (getline(&line, &cap, f) >= 0) {
+        snprintf(where, sizeof(where), "%s:%d", path, ++lineno);
+        if (add_spec(set, line, occurrence, where) < 0) {
+            ret = -1;
             break;
         }
     }
+    free(line);
+    fclose(f);
+    return ret;
+}
 
-    if (patch_at < 0) {
-        fprintf(stderr, "Error: pattern BA 21 00 00 00 not found!\n");
-        free(buf);
+static void free_patterns(struct pattern_set *set)
+{
+    for (size_t i = 0; i < set->n; i++) {
+        free(set->v[i].text);
+        free(set->v[i].old_bytes);
+        free(set->v[i].new_bytes);
+    }
+    free(set->v);
+}
+
+// ---------------------------------------------------------------------------
+// Aho-Corasick
+// ---------------------------------------------------------------------------
+
+static int32_t ac_new_state(struct automaton *ac, size_t *cap)
+{
+    if (ac->nstates == *cap) {
+        *cap *= 2;
+        ac->next = xrealloc(ac->next, *cap * sizeof(*ac->next));
+        ac->out = xrealloc(ac->out, *cap * sizeof(*ac->out));
+        ac->dict = xrealloc(ac->dict, *cap * sizeof(*ac->dict));
+    }
+    int32_t s = (int32_t)ac->nstates++;
+    memset(ac->next[s], 0xff, sizeof(ac->next[s]));   // -1: no edge yet
+    ac->out[s] = -1;
+    ac->dict[s] = -1;
+    return s;
+}
+
+static void ac_build(struct automaton *ac, struct pattern_set *set)
+{
+    size_t cap = 64;
+    memset(ac, 0, sizeof(*ac));
+    ac->next = xrealloc(NULL, cap * sizeof(*ac->next));
+    ac->out = xrealloc(NULL, cap * sizeof(*ac->out));
+    ac->dict = xrealloc(NULL, cap * sizeof(*ac->dict));
+    ac_new_state(ac, &cap);
+
+    // Trie of all patterns
+    for (size_t i = 0; i < set->n; i++) {
+        int32_t s = 0;
+        for (size_t j = 0; j < set->v[i].len; j++) {
+            uint8_t c = set->v[i].old_bytes[j];
+            if (ac->next[s][c] < 0) {
+                int32_t t = ac_new_state(ac, &cap);
+                ac->next[s][c] = t;
+            }
+            s = ac->next[s][c];
+        }
+        set->v[i].next_same_state = ac->out[s];
+        ac->out[s] = (int32_t)i;
+    }
+
+    // Breadth-first: compute failure links and fill in the missing edges
+    int32_t *fail = xrealloc(NULL, ac->nstates * sizeof(*fail));
+    int32_t *queue = xrealloc(NULL, ac->nstates * sizeof(*queue));
+    size_t head = 0, tail = 0;
+    int roots = 0;
+
+    for (int c = 0; c < 256; c++) {
+        int32_t t = ac->next[0][c];
+        if (t < 0) {
+            ac->next[0][c] = 0;
+        } else {
+            fail[t] = 0;
+            queue[tail++] = t;
+            ac->starts[c] = 1;
+            ac->first_byte = roots++ ? -1 : c;
+        }
+    }
+    while (head < tail) {
+        int32_t s = queue[head++];
+        for (int c = 0; c < 256; c++) {
+            int32_t t = ac->next[s][c];
+            if (t < 0) {
+                ac->next[s][c] = ac->next[fail[s]][c];
+                continue;
+            }
+            int32_t f = ac->next[fail[s]][c];
+            fail[t] = f;
+            ac->dict[t] = ac->out[f] >= 0 ? f : ac->dict[f];
+            queue[tail++] = t;
+        }
+    }
+
+    // Mark edges into reporting states
+    for (size_t s = 0; s < ac->nstates; s++) {
+        for (int c = 0; c < 256; c++) {
+            int32_t t = ac->next[s][c];
+            if (ac->out[t] >= 0 || ac->dict[t] >= 0)
+                ac->next[s][c] = ~t;
+        }
+    }
+    free(fail);
+    free(queue);
+}
+
+static void ac_free(struct automaton *ac)
+{
+    free(ac->next);
+    free(ac->out);
+    free(ac->dict);
+}
+
+// Called for each match with its start offset; a nonzero return stops the scan
+typedef int (*match_fn)(int pattern, size_t offset, void *ctx);
+
+// Scan buf[start, end) and report every match of every pattern.
+// Returns 1 if on_match stopped the scan.
+static int ac_scan(const struct automaton *ac, const struct pattern_set *set,
+                   const uint8_t *buf, size_t start, size_t end,
+                   match_fn on_match, void *ctx)
+{
+    int32_t s = 0;
+    for (size_t i = start; i < end; i++) {
+        if (s == 0) {
+            // In the root, skip bytes that cannot start a match without
+            // walking the automaton: memchr for a single first byte,
+            // a table lookup (no dependency between bytes) otherwise
+            if (ac->first_byte >= 0) {
+                const uint8_t *hit = memchr(buf + i, ac->first_byte, end - i);
+                if (!hit)
+                    return 0;
+                i = (size_t)(hit - buf);
+            } else {
+                while (i < end && !ac->starts[buf[i]])
+                    i++;
+                if (i == end)
+                    return 0;
+            }
+        }
+        s = ac->next[s][buf[i]];
+        if (s >= 0)
+            continue;
+
+        s = ~s;
+        for (int32_t t = ac->out[s] >= 0 ? s : ac->dict[s]; t >= 0;
+             t = ac->dict[t]) {
+            for (int p = ac->out[t]; p >= 0; p = set->v[p].next_same_state) {
+                if (on_match(p, i + 1 - set->v[p].len, ctx))
+                    return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// ELF layout
+// ---------------------------------------------------------------------------
+
+// A section, or a PT_LOAD segment, as a file range and its load address
+struct elf_range {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t addr;
+    uint32_t flags;         // p_flags of segments
+    const char *name;       // section name, points into the mapping
+};
+
+struct elf_layout {
+    struct elf_range *sections;
+    size_t nsections;
+    struct elf_range *segments;
+    size_t nsegments;
+};
+
+// Read a section header of either class; returns -1 if out of bounds
+static int elf_shdr(const uint8_t *map, size_t size, int is64, uint64_t off,
+                    Elf64_Shdr *sh)
+{
+    if (is64) {
+        if (off > size || size - off < sizeof(Elf64_Shdr))
+            return -1;
+        memcpy(sh, map + off, sizeof(*sh));
+        return 0;
+    }
+
+    Elf32_Shdr sh32;
+    if (off > size || size - off < sizeof(sh32))
+        return -1;
+    memcpy(&sh32, map + off, sizeof(sh32));
+    sh->sh_name = sh32.sh_name;
+    sh->sh_type = sh32.sh_type;
+    sh->sh_addr = sh32.sh_addr;
+    sh->sh_offset = sh32.sh_offset;
+    sh->sh_size = sh32.sh_size;
+    sh->sh_link = sh32.sh_link;
+    return 0;
+}
+
+static void add_range(struct elf_range **v, size_t *n, struct elf_range r)
+{
+    *v = xrealloc(*v, (*n + 1) * sizeof(**v));
+    (*v)[(*n)++] = r;
+}
+
+// Parse the section and program headers of a little-endian ELF file.
+// Returns -1 if map is not one; malformed headers are ignored.
+static int elf_parse(const uint8_t *map, size_t size, struct elf_layout *elf)
+{
+    memset(elf, 0, sizeof(*elf));
+    if (size < EI_NIDENT || memcmp(map, ELFMAG, SELFMAG) != 0)
+        return -1;
+    if (map[EI_DATA] != ELFDATA2LSB)
+        return -1;
+
+    int is64 = map[EI_CLASS] == ELFCLASS64;
+    uint64_t phoff, shoff;
+    size_t phnum, shnum, phentsize, shentsize, shstrndx;
+    if (is64) {
+        Elf64_Ehdr eh;
+        if (size < sizeof(eh))
+            return -1;
+        memcpy(&eh, map, sizeof(eh));
+        phoff = eh.e_phoff; phnum = eh.e_phnum; phentsize = eh.e_phentsize;
+        shoff = eh.e_shoff; shnum = eh.e_shnum; shentsize = eh.e_shentsize;
+        shstrndx = eh.e_shstrndx;
+    } else if (map[EI_CLASS] == ELFCLASS32) {
+        Elf32_Ehdr eh;
+        if (size < sizeof(eh))
+            return -1;
+        memcpy(&eh, map, sizeof(eh));
+        phoff = eh.e_phoff; phnum = eh.e_phnum; phentsize = eh.e_phentsize;
+        shoff = eh.e_shoff; shnum = eh.e_shnum; shentsize = eh.e_shentsize;
+        shstrndx = eh.e_shstrndx;
+    } else {
+        return -1;
+    }
+
+    // PT_LOAD segments
+    for (size_t i = 0; phentsize && i < phnum; i++) {
+        uint64_t off = phoff + i * phentsize;
+        struct elf_range r = {0};
+        uint32_t type;
+        if (is64) {
+            Elf64_Phdr ph;
+            if (off > size || size - off < sizeof(ph))
+                break;
+            memcpy(&ph, map + off, sizeof(ph));
+            type = ph.p_type;
+            r = (struct elf_range){ ph.p_offset, ph.p_filesz, ph.p_vaddr,
+                                    ph.p_flags, NULL };
+        } else {
+            Elf32_Phdr ph;
+            if (off > size || size - off < sizeof(ph))
+                break;
+            memcpy(&ph, map + off, sizeof(ph));
+            type = ph.p_type;
+            r = (struct elf_range){ ph.p_offset, ph.p_filesz, ph.p_vaddr,
+                                    ph.p_flags, NULL };
+        }
+        if (type == PT_LOAD)
+            add_range(&elf->segments, &elf->nsegments, r);
+    }
+
+    // Sections, named from .shstrtab; counts past 0xff00 are in section 0
+    Elf64_Shdr sh;
+    if (!shoff || !shentsize || elf_shdr(map, size, is64, shoff, &sh) < 0)
+        return 0;
+    if (shnum == 0)
+        shnum = sh.sh_size;
+    if (shstrndx == SHN_XINDEX)
+        shstrndx = sh.sh_link;
+
+    Elf64_Shdr strtab;
+    if (shstrndx >= shnum ||
+        elf_shdr(map, size, is64, shoff + shstrndx * shentsize, &strtab) < 0 ||
+        strtab.sh_offset > size || size - strtab.sh_offset < strtab.sh_size)
+        return 0;
+    const char *names = (const char *)map + strtab.sh_offset;
+
+    for (size_t i = 1; i < shnum; i++) {
+        if (elf_shdr(map, size, is64, shoff + i * shentsize, &sh) < 0)
+            break;
+        if (sh.sh_type == SHT_NULL || sh.sh_type == SHT_NOBITS)
+            continue;
+        if (sh.sh_name >= strtab.sh_size ||
+            !memchr(names + sh.sh_name, '\0', strtab.sh_size - sh.sh_name))
+            continue;
+        struct elf_range r = { sh.sh_offset, sh.sh_size, sh.sh_addr, 0,
+                               names + sh.sh_name };
+        add_range(&elf->sections, &elf->nsections, r);
+    }
+    return 0;
+}
+
+static void elf_free(struct elf_layout *elf)
+{
+    free(elf->sections);
+    free(elf->segments);
+}
+
+static const struct elf_range *find_range(const struct elf_range *v, size_t n,
+                                          uint64_t offset)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (offset >= v[i].offset && offset - v[i].offset < v[i].size)
+            return &v[i];
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Patching one file
+// ---------------------------------------------------------------------------
+
+struct options {
+    const char **sections;  // -s: only match in these sections
+    int nsections;
+    int exec_only;          // -x: only match in executable segments
+    int make_dirs;          // create missing parent directories of outputs
+    int partial;            // --partial: unapplied patterns are not a failure
+};
+
+struct scan_range {
+    size_t start, end;
+};
+
+static int compare_ranges(const void *a, const void *b)
+{
+    const struct scan_range *x = a, *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+// File ranges to match in: the whole file, or the requested sections and
+// executable segments, sorted and merged. Returns the number of ranges.
+static size_t scan_ranges(const struct options *opt,
+                          const struct elf_layout *elf, size_t fsize,
+                          struct scan_range **out)
+{
+    struct scan_range *v = NULL;
+    size_t n = 0;
+
+    if (opt->nsections == 0 && !opt->exec_only) {
+        v = xrealloc(NULL, sizeof(*v));
+        v[n++] = (struct scan_range){ 0, fsize };
+        *out = v;
+        return n;
+    }
+
+    for (size_t i = 0; i < elf->nsections; i++) {
+        for (int j = 0; j < opt->nsections; j++) {
+            if (strcmp(elf->sections[i].name, opt->sections[j]) != 0)
+                continue;
+            v = xrealloc(v, (n + 1) * sizeof(*v));
+            v[n++] = (struct scan_range){ elf->sections[i].offset,
+                                          elf->sections[i].offset +
+                                          elf->sections[i].size };
+            break;
+        }
+    }
+    for (size_t i = 0; opt->exec_only && i < elf->nsegments; i++) {
+        if (!(elf->segments[i].flags & PF_X))
+            continue;
+        v = xrealloc(v, (n + 1) * sizeof(*v));
+        v[n++] = (struct scan_range){ elf->segments[i].offset,
+                                      elf->segments[i].offset +
+                                      elf->segments[i].size };
+    }
+
+    // Clip to the file, then merge overlaps so no byte is scanned twice
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (v[i].start >= fsize)
+            continue;
+        if (v[i].end > fsize)
+            v[i].end = fsize;
+        v[m++] = v[i];
+    }
+    qsort(v, m, sizeof(*v), compare_ranges);
+    n = 0;
+    for (size_t i = 0; i < m; i++) {
+        if (n && v[i].start <= v[n - 1].end) {
+            if (v[i].end > v[n - 1].end)
+                v[n - 1].end = v[i].end;
+        } else {
+            v[n++] = v[i];
+        }
+    }
+    *out = v;
+    return n;
+}
+
+struct select_ctx {
+    const struct pattern_set *set;
+    struct pattern_count *counts;
+    struct edit_list *edits;
+    size_t patched_end;     // end of the last accepted edit
+    size_t pending;         // patterns still waiting for their Nth match
+    int any_all;            // some pattern patches every match
+};
+
+static int select_match(int p, size_t offset, void *arg)
+{
+    struct select_ctx *ctx = arg;
+    const struct pattern *pat = &ctx->set->v[p];
+    struct pattern_count *count = &ctx->counts[p];
+
+    count->seen++;
+    if (pat->occurrence != OCCURRENCE_ALL &&
+        count->seen != (size_t)pat->occurrence)
+        return 0;
+
+    // Never let two patches overwrite the same bytes
+    if (ctx->edits->n && offset < ctx->patched_end) {
+        count->overlapped++;
+        return 0;
+    }
+
+    struct edit_list *e = ctx->edits;
+    if (e->n == e->cap) {
+        e->cap = e->cap ? e->cap * 2 : 16;
+        e->v = xrealloc(e->v, e->cap * sizeof(*e->v));
+    }
+    e->v[e->n++] = (struct edit){ .offset = offset, .pattern = p };
+    ctx->patched_end = offset + pat->len;
+    count->applied++;
+
+    if (pat->occurrence != OCCURRENCE_ALL && --ctx->pending == 0 && !ctx->any_all)
+        return 1;   // every pattern has its match, the rest is not needed
+    return 0;
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len, off_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+// Make out a copy of in: share extents with a reflink where the filesystem
+// supports it, otherwise copy in the kernel, otherwise write from the mapping.
+static int copy_contents(int in, int out, const uint8_t *map, size_t size)
+{
+    if (ioctl(out, FICLONE, in) == 0)
+        return 0;
+
+    size_t done = 0;
+    while (done < size) {
+        loff_t off_in = (loff_t)done, off_out = (loff_t)done;
+        ssize_t n = copy_file_range(in, &off_in, out, &off_out, size - done, 0);
+        if (n > 0) {
+            done += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n == 0 || (done == 0 && (errno == EXDEV || errno == ENOSYS ||
+                                     errno == EINVAL || errno == EOPNOTSUPP)))
+            break;
+        return -1;
+    }
+    if (done < size && write_all(out, map + done, size - done, (off_t)done) < 0)
+        return -1;
+    return 0;
+}
+
+// mkdir -p for the directory part of path
+static int make_parent_dirs(const char *path)
+{
+    char *dir = strdup(path);
+    for (char *p = strchr(dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        if (mkdir(dir, 0777) < 0 && errno != EEXIST) {
+            free(dir);
+            return -1;
+        }
+        *p = '/';
+    }
+    free(dir);
+    return 0;
+}
+
+enum file_status { FILE_PATCHED, FILE_UNCHANGED, FILE_SKIPPED, FILE_ERROR };
+
+struct file_result {
+    char *path;
+    char *output;
+    enum file_status status;
+    char error[256];
+    struct edit_list edits;
+    struct pattern_count *counts;
+};
+
+#define FAIL(r, status_, ...) do {                                  \
+        (r)->status = (status_);                                    \
+        snprintf((r)->error, sizeof((r)->error), __VA_ARGS__);      \
+    } while (0)
+
+// Find the patches for r->path and write r->output. Only reads the shared
+// automaton and patterns, so files can be patched from several threads.
+static void patch_file(const struct automaton *ac, const struct pattern_set *set,
+                       const struct options *opt, struct file_result *r)
+{
+    int fin = -1, fout = -1;
+    const uint8_t *map = NULL;
+    size_t fsize = 0;
+    struct elf_layout elf = {0};
+    struct scan_range *ranges = NULL;
+
+    r->counts = xrealloc(NULL, set->n * sizeof(*r->counts));
+    memset(r->counts, 0, set->n * sizeof(*r->counts));
+
+    fin = open(r->path, O_RDONLY);
+    if (fin < 0) { FAIL(r, FILE_ERROR, "open input: %s", strerror(errno)); goto out; }
+
+    struct stat st;
+    if (fstat(fin, &st) < 0) { FAIL(r, FILE_ERROR, "fstat input: %s", strerror(errno)); goto out; }
+    fsize = (size_t)st.st_size;
+
+    // Map the input instead of copying it into a buffer
+    if (fsize > 0) {
+        map = mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fin, 0);
+        if (map == MAP_FAILED) {
+            map = NULL;
+            FAIL(r, FILE_ERROR, "mmap: %s", strerror(errno));
+            goto out;
+        }
+        madvise((void *)map, fsize, MADV_SEQUENTIAL);
+    }
+
+    int is_elf = map && elf_parse(map, fsize, &elf) == 0;
+    if (!is_elf && (opt->nsections || opt->exec_only)) {
+        FAIL(r, FILE_SKIPPED, "not a little-endian ELF file");
+        goto out;
+    }
+
+    // Find all patches before writing anything
+    struct select_ctx ctx = { .set = set, .counts = r->counts, .edits = &r->edits };
+    for (size_t i = 0; i < set->n; i++) {
+        if (set->v[i].occurrence == OCCURRENCE_ALL)
+            ctx.any_all = 1;
+        else
+            ctx.pending++;
+    }
+    size_t nranges = scan_ranges(opt, &elf, fsize, &ranges);
+    if (nranges == 0) {
+        FAIL(r, FILE_SKIPPED, "no matching sections or segments");
+        goto out;
+    }
+    for (size_t i = 0; map && i < nranges; i++) {
+        if (ac_scan(ac, set, map, ranges[i].start, ranges[i].end,
+                    select_match, &ctx))
+            break;
+    }
+    if (r->edits.n == 0) {
+        r->status = FILE_UNCHANGED;
+        goto out;
+    }
+
+    // Where each patch lands in memory
+    for (size_t i = 0; i < r->edits.n; i++) {
+        struct edit *e = &r->edits.v[i];
+        const struct elf_range *seg = find_range(elf.segments, elf.nsegments,
+                                                 e->offset);
+        const struct elf_range *sec = find_range(elf.sections, elf.nsections,
+                                                 e->offset);
+        if (seg) {
+            e->has_vaddr = 1;
+            e->vaddr = seg->addr + (e->offset - seg->offset);
+        }
+        if (sec)
+            e->section = strdup(sec->name);
+    }
+
+    // Patching the input itself skips the copy
+    struct stat out_st;
+    int in_place = stat(r->output, &out_st) == 0 &&
+                   out_st.st_dev == st.st_dev && out_st.st_ino == st.st_ino;
+    if (!in_place && opt->make_dirs && make_parent_dirs(r->output) < 0) {
+        FAIL(r, FILE_ERROR, "mkdir: %s", strerror(errno));
+        goto out;
+    }
+    fout = open(r->output, O_WRONLY | O_CREAT | (in_place ? 0 : O_TRUNC),
+                st.st_mode & 0777);
+    if (fout < 0) { FAIL(r, FILE_ERROR, "open output: %s", strerror(errno)); goto out; }
+    if (!in_place && copy_contents(fin, fout, map, fsize) < 0) {
+        FAIL(r, FILE_ERROR, "copy output: %s", strerror(errno));
+        goto out;
+    }
+
+    // Write only the changed bytes
+    for (size_t i = 0; i < r->edits.n; i++) {
+        const struct pattern *p = &set->v[r->edits.v[i].pattern];
+        if (write_all(fout, p->new_bytes, p->len,
+                      (off_t)r->edits.v[i].offset) < 0) {
+            FAIL(r, FILE_ERROR, "pwrite: %s", strerror(errno));
+            goto out;
+        }
+    }
+    int ret = close(fout);
+    fout = -1;
+    if (ret < 0) { FAIL(r, FILE_ERROR, "close output: %s", strerror(errno)); goto out; }
+    r->status = FILE_PATCHED;
+
+out:
+    if (fout >= 0)
+        close(fout);
+    if (map)
+        munmap((void *)map, fsize);
+    if (fin >= 0)
+        close(fin);
+    elf_free(&elf);
+    free(ranges);
+}
+
+// Number of patterns that could not be applied to a patched file
+static size_t missing_patterns(const struct pattern_set *set,
+                               const struct file_result *r)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < set->n; i++)
+        n += r->counts[i].applied == 0;
+    return n;
+}
+
+static void free_result(struct file_result *r)
+{
+    for (size_t i = 0; i < r->edits.n; i++)
+        free(r->edits.v[i].section);
+    free(r->edits.v);
+    free(r->counts);
+    free(r->path);
+    free(r->output);
+}
+
+// ---------------------------------------------------------------------------
+// Batch mode
+// ---------------------------------------------------------------------------
+
+struct batch {
+    const struct automaton *ac;
+    const struct pattern_set *set;
+    const struct options *opt;
+    struct file_result *files;
+    size_t nfiles;
+    size_t next;            // next file to claim, shared by the workers
+};
+
+static void *batch_worker(void *arg)
+{
+    struct batch *b = arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->nfiles)
+            return NULL;
+        patch_file(b->ac, b->set, b->opt, &b->files[i]);
+    }
+}
+
+// nftw() has no context argument, so the walk collects into this
+static struct {
+    struct file_result *v;
+    size_t n, cap;
+    size_t in_len;          // in_dir and out_dir without trailing slashes
+    const char *out_dir;
+    size_t out_len;
+    struct stat out_st;
+    int skip_out;           // output directory is inside the input tree
+} walk;
+
+static int collect_file(const char *path, const struct stat *st, int type,
+                        struct FTW *ftw)
+{
+    (void)ftw;
+    if (type == FTW_D && walk.skip_out && st->st_dev == walk.out_st.st_dev &&
+        st->st_ino == walk.out_st.st_ino)
+        return FTW_SKIP_SUBTREE;
+    if (type != FTW_F || !S_ISREG(st->st_mode))
+        return FTW_CONTINUE;
+
+    if (walk.n == walk.cap) {
+        walk.cap = walk.cap ? walk.cap * 2 : 256;
+        walk.v = xrealloc(walk.v, walk.cap * sizeof(*walk.v));
+    }
+    struct file_result *r = &walk.v[walk.n++];
+    memset(r, 0, sizeof(*r));
+    r->path = strdup(path);
+    // path + in_len starts with the '/' after the input directory
+    if (asprintf(&r->output, "%.*s%s", (int)walk.out_len, walk.out_dir,
+                 path + walk.in_len) < 0) {
+        perror("asprintf");
+        exit(1);
+    }
+    return FTW_CONTINUE;
+}
+
+static int compare_results(const void *a, const void *b)
+{
+    return strcmp(((const struct file_result *)a)->path,
+                  ((const struct file_result *)b)->path);
+}
+
+static void json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void json_hex(FILE *f, const uint8_t *b, size_t n)
+{
+    fputc('"', f);
+    for (size_t i = 0; i < n; i++)
+        fprintf(f, i ? " %02X" : "%02X", b[i]);
+    fputc('"', f);
+}
+
+static const char *const status_names[] = {
+    [FILE_PATCHED] = "patched",
+    [FILE_UNCHANGED] = "unchanged",
+    [FILE_SKIPPED] = "skipped",
+    [FILE_ERROR] = "error",
+};
+
+// JSON manifest of the patched files and of the files that failed;
+// unchanged and skipped files are only counted
+static int write_manifest(const char *path, const char *in_dir,
+                          const char *out_dir, const struct pattern_set *set,
+                          const struct options *opt,
+                          const struct file_result *files, size_t nfiles)
+{
+    FILE *f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    size_t totals[4] = {0};
+    for (size_t i = 0; i < nfiles; i++)
+        totals[files[i].status]++;
+
+    fprintf(f, "{\n  \"input\": ");
+    json_string(f, in_dir);
+    fprintf(f, ",\n  \"output\": ");
+    json_string(f, out_dir);
+    fprintf(f, ",\n  \"patterns\": [");
+    for (size_t i = 0; i < set->n; i++) {
+        fprintf(f, "%s\n    {\"old\": ", i ? "," : "");
+        json_hex(f, set->v[i].old_bytes, set->v[i].len);
+        fprintf(f, ", \"new\": ");
+        json_hex(f, set->v[i].new_bytes, set->v[i].len);
+        if (set->v[i].occurrence == OCCURRENCE_ALL)
+            fprintf(f, ", \"occurrence\": \"all\"}");
+        else
+            fprintf(f, ", \"occurrence\": %ld}", set->v[i].occurrence);
+    }
+    fprintf(f, "\n  ],\n  \"sections\": [");
+    for (int i = 0; i < opt->nsections; i++) {
+        fprintf(f, i ? ", " : "");
+        json_string(f, opt->sections[i]);
+    }
+    fprintf(f, "],\n  \"executable_only\": %s,\n",
+            opt->exec_only ? "true" : "false");
+    fprintf(f, "  \"summary\": {\"files\": %zu, \"patched\": %zu, "
+            "\"unchanged\": %zu, \"skipped\": %zu, \"errors\": %zu},\n",
+            nfiles, totals[FILE_PATCHED], totals[FILE_UNCHANGED],
+            totals[FILE_SKIPPED], totals[FILE_ERROR]);
+
+    fprintf(f, "  \"files\": [");
+    int first = 1;
+    for (size_t i = 0; i < nfiles; i++) {
+        const struct file_result *r = &files[i];
+        if (r->status != FILE_PATCHED && r->status != FILE_ERROR)
+            continue;
+        fprintf(f, "%s\n    {\"path\": ", first ? "" : ",");
+        first = 0;
+        json_string(f, r->path);
+        fprintf(f, ", \"status\": \"%s\"", status_names[r->status]);
+        if (r->status == FILE_ERROR) {
+            fprintf(f, ", \"error\": ");
+            json_string(f, r->error);
+            fprintf(f, "}");
+            continue;
+        }
+
+        fprintf(f, ", \"output\": ");
+        json_string(f, r->output);
+        fprintf(f, ",\n     \"patches\": [");
+        for (size_t j = 0; j < r->edits.n; j++) {
+            const struct edit *e = &r->edits.v[j];
+            fprintf(f, "%s\n       {\"pattern\": %d, \"offset\": %zu",
+                    j ? "," : "", e->pattern, e->offset);
+            if (e->has_vaddr)
+                fprintf(f, ", \"vaddr\": %" PRIu64, e->vaddr);
+            if (e->section) {
+                fprintf(f, ", \"section\": ");
+                json_string(f, e->section);
+            }
+            fprintf(f, "}");
+        }
+        fprintf(f, "]");
+
+        // Patterns that were wanted here but could not be applied
+        int any = 0;
+        for (size_t j = 0; j < set->n; j++) {
+            if (r->counts[j].applied)
+                continue;
+            fprintf(f, "%s%zu", any ? ", " : ",\n     \"missing\": [", j);
+            any = 1;
+        }
+        fprintf(f, "%s}", any ? "]" : "");
+    }
+    fprintf(f, "%s]\n}\n", first ? "" : "\n  ");
+
+    if (f != stdout && fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+static int run_batch(const struct automaton *ac, const struct pattern_set *set,
+                     struct options *opt, const char *in_dir,
+                     const char *out_dir, const char *manifest, long jobs)
+{
+    struct stat in_st;
+    if (stat(in_dir, &in_st) < 0) { perror(in_dir); return 1; }
+
+    walk.in_len = strlen(in_dir);
+    while (walk.in_len > 0 && in_dir[walk.in_len - 1] == '/')
+        walk.in_len--;
+    walk.out_dir = out_dir;
+    walk.out_len = strlen(out_dir);
+    while (walk.out_len > 0 && out_dir[walk.out_len - 1] == '/')
+        walk.out_len--;
+    walk.skip_out = stat(out_dir, &walk.out_st) == 0 &&
+                    (walk.out_st.st_dev != in_st.st_dev ||
+                     walk.out_st.st_ino != in_st.st_ino);
+    if (nftw(in_dir, collect_file, 64, FTW_PHYS | FTW_ACTIONRETVAL) < 0) {
+        perror("nftw");
         return 1;
     }
+    qsort(walk.v, walk.n, sizeof(*walk.v), compare_results);
 
-    // Apply the patch
-    memcpy(buf + patch_at, new_pat, 5);
-    printf("Patch applied at file offset 0x%lX\n", patch_at);
+    opt->make_dirs = 1;
+    struct batch b = { .ac = ac, .set = set, .opt = opt,
+                       .files = walk.v, .nfiles = walk.n };
+    if (jobs > (long)walk.n)
+        jobs = walk.n ? (long)walk.n : 1;
+    pthread_t *threads = xrealloc(NULL, (size_t)jobs * sizeof(*threads));
+    long started = 0;
+    for (; started < jobs; started++) {
+        if (pthread_create(&threads[started], NULL, batch_worker, &b) != 0)
+            break;
+    }
+    if (started == 0)
+        batch_worker(&b);
+    for (long i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
 
-    // Write out the patched binary
-    FILE *fout = fopen(out_path, "wb");
-    if (!fout) { perror("fopen output"); free(buf); return 1; }
-    if (fwrite(buf, 1, fsize, fout) != fsize) {
-        perror("fwrite");
-        fclose(fout);
-        free(buf);
+    size_t patched = 0, partial = 0, errors = 0;
+    for (size_t i = 0; i < walk.n; i++) {
+        if (walk.v[i].status == FILE_PATCHED) {
+            patched++;
+            partial += missing_patterns(set, &walk.v[i]) != 0;
+        }
+        if (walk.v[i].status == FILE_ERROR) {
+            fprintf(stderr, "%s: %s\n", walk.v[i].path, walk.v[i].error);
+            errors++;
+        }
+    }
+    int ret = write_manifest(manifest, in_dir, out_dir, set, opt,
+                             walk.v, walk.n) < 0;
+    fprintf(stderr, "Patched %zu of %zu files (%zu partial, %zu errors), "
+            "%ld thread(s)\n", patched, walk.n, partial, errors,
+            started ? started : 1);
+
+    for (size_t i = 0; i < walk.n; i++)
+        free_result(&walk.v[i]);
+    free(walk.v);
+    return ret || errors || patched == 0 || (partial && !opt->partial);
+}
+
+// ---------------------------------------------------------------------------
+// Command line
+// ---------------------------------------------------------------------------
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-p SPEC_FILE] [-e 'OLD = NEW'] [-n N | -a] "
+            "[-s SECTION] [-x]\n"
+            "          [-j N] [-m MANIFEST] [--partial] <input> <output>\n"
+            "  -p FILE     read patterns from FILE, one 'OLD = NEW [@N|@all]' per line\n"
+            "  -e SPEC     add one pattern (repeatable)\n"
+            "  -n N        patch the Nth match of each pattern (default: 1)\n"
+            "  -a          patch every match of each pattern\n"
+            "  -s SECTION  only match inside this ELF section (repeatable)\n"
+            "  -x          only match inside executable ELF segments\n"
+            "  -j N        batch mode: patch N files at a time (default: CPUs)\n"
+            "  -m FILE     batch mode: write the JSON manifest to FILE "
+            "(default: stdout)\n"
+            "  --partial   exit 0 even if a pattern could not be applied\n"
+            "Without -p or -e, patches the first '" DEFAULT_SPEC "'.\n"
+            "If output is input, it is patched in place. If input is a "
+            "directory,\nevery regular file below it is patched into the "
+            "same path under output.\n",
+            prog);
+}
+
+static void print_result(const struct pattern_set *set,
+                         const struct options *opt,
+                         const struct file_result *r)
+{
+    const char *level = opt->partial ? "Warning" : "Error";
+
+    for (size_t i = 0; i < r->edits.n; i++) {
+        const struct edit *e = &r->edits.v[i];
+        printf("Patch applied at file offset 0x%zX", e->offset);
+        if (e->has_vaddr)
+            printf(", vaddr 0x%" PRIX64, e->vaddr);
+        if (e->section)
+            printf(" in %s", e->section);
+        printf(" (%s)\n", set->v[e->pattern].text);
+    }
+
+    for (size_t i = 0; i < set->n; i++) {
+        const struct pattern *p = &set->v[i];
+        const struct pattern_count *c = &r->counts[i];
+        if (c->overlapped)
+            fprintf(stderr, "Warning: skipped %zu match(es) of %s that overlap "
+                    "an earlier patch\n", c->overlapped, p->text);
+        if (c->applied)
+            continue;
+        if (c->seen == 0)
+            fprintf(stderr, "%s: pattern %s not found!\n", level, p->text);
+        else
+            fprintf(stderr, "%s: pattern %s has only %zu match(es), "
+                    "wanted match %ld\n", level, p->text, c->seen,
+                    p->occurrence);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct pattern_set set = {0};
+    struct options opt = {0};
+    const char *spec_files[64];
+    const char *inline_specs[64];
+    const char *sections[64];
+    const char *manifest = "-";
+    int nfiles = 0, ninline = 0;
+    long occurrence = 1;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt_char;
+    static const struct option long_opts[] = {
+        { "partial", no_argument, NULL, 'P' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    while ((opt_char = getopt_long(argc, argv, "p:e:n:as:xj:m:h", long_opts,
+                                   NULL)) != -1) {
+        switch (opt_char) {
+        case 'p':
+        case 'e':
+            if (nfiles + ninline == 64) {
+                fprintf(stderr, "Error: too many -p/-e options\n");
+                return 1;
+            }
+            if (opt_char == 'p')
+                spec_files[nfiles++] = optarg;
+            else
+                inline_specs[ninline++] = optarg;
+            break;
+        case 'n':
+        case 'j': {
+            char *end;
+            long v = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || v < 1) {
+                fprintf(stderr, "Error: -%c needs a positive number\n", opt_char);
+                return 1;
+            }
+            if (opt_char == 'n')
+                occurrence = v;
+            else
+                jobs = v;
+            break;
+        }
+        case 'a':
+            occurrence = OCCURRENCE_ALL;
+            break;
+        case 's':
+            if (opt.nsections == 64) {
+                fprintf(stderr, "Error: too many -s options\n");
+                return 1;
+            }
+            sections[opt.nsections++] = optarg;
+            break;
+        case 'x':
+            opt.exec_only = 1;
+            break;
+        case 'm':
+            manifest = optarg;
+            break;
+        case 'P':
+            opt.partial = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt_char == 'h' ? 0 : 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
         return 1;
     }
-    fclose(fout);
-    free(buf);
+    opt.sections = sections;
+    if (jobs < 1)
+        jobs = 1;
 
-    printf("Patched binary written to: %s\n", out_path);
-    return 0;
+    // -n/-a apply to every spec, so specs are parsed after all options
+    for (int i = 0; i < nfiles; i++) {
+        if (load_spec_file(&set, spec_files[i], occurrence) < 0)
+            return 1;
+    }
+    for (int i = 0; i < ninline; i++) {
+        if (add_spec(&set, inline_specs[i], occurrence, "-e") < 0)
+            return 1;
+    }
+    if (nfiles + ninline == 0)
+        add_spec(&set, DEFAULT_SPEC, occurrence, "default");
+    if (set.n == 0) {
+        fprintf(stderr, "Error: no patterns given\n");
+        return 1;
+    }
+
+    struct automaton ac;
+    ac_build(&ac, &set);
+
+    const char *in_path  = argv[optind];
+    const char *out_path = argv[optind + 1];
+    struct stat st;
+    int ret;
+    if (stat(in_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        ret = run_batch(&ac, &set, &opt, in_path, out_path, manifest, jobs);
+    } else {
+        struct file_result r = { .path = strdup(in_path),
+                                 .output = strdup(out_path) };
+        patch_file(&ac, &set, &opt, &r);
+        if (r.status == FILE_ERROR || r.status == FILE_SKIPPED)
+            fprintf(stderr, "Error: %s: %s\n", in_path, r.error);
+        else
+            print_result(&set, &opt, &r);
+        if (r.status == FILE_PATCHED)
+            printf("Patched binary written to: %s\n", out_path);
+        ret = r.status != FILE_PATCHED ||
+              (!opt.partial && missing_patterns(&set, &r));
+        free_result(&r);
+    }
+
+    ac_free(&ac);
+    free_patterns(&set);
+    return ret;
 }
@@ -0,0 +1,7 @@
+# U-Boot script for the Lab 3 SD card; build.sh turns it into boot.scr.
+# The default boot command of vexpress_ca9x4 runs boot.scr from partition 1.
+setenv bootargs console=ttyAMA0 printk.time=1
+load mmc 0:1 ${kernel_addr_r} zImage
+load mmc 0:1 ${fdt_addr_r} vexpress.dtb
+load mmc 0:1 ${ramdisk_addr_r} uInitrd
+bootz ${kernel_addr_r} ${ramdisk_addr_r} ${fdt_addr_r}
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""
+Lab 3 boot-time profiler
+
+Boots the SD image from build.sh in qemu-system-arm (vexpress-a9, U-Boot
+as -kernel), timestamps every serial console line on arrival and splits
+the boot at fixed markers into stages:
+
+  qemu         QEMU start            -> U-Boot banner
+  u-boot       U-Boot banner         -> "Starting kernel ..."
+  decompress   "Starting kernel ..." -> "Booting Linux on physical CPU"
+  kernel       "Booting Linux ..."   -> "Run /init as init process" or "[boot] init"
+  initramfs    "[boot] init"         -> "[boot] switch_root"
+  switch_root  "[boot] switch_root"  -> "[OK] rcS script started."
+  rcS          "[OK] rcS ..."        -> "[boot] rcS done"
+  shell        "[boot] rcS done"     -> the shell prompt on the rootfs
+
+The [boot] markers are printed by overlay/initramfs/init and the rootfs
+rcS. A marker that never shows up (say, the kernel banner under "quiet")
+folds its stage into the next one. Each run is reported as a JSON line,
+followed by a table of per-stage medians over all runs:
+
+  {"run": 0, "total_s": 4.81, "stages": {"qemu": 0.05, "u-boot": 1.42, ...},
+   "printk_s": {"init": 1.93, ...}, "unpack_s": 0.112, ...}
+
+total_s is the time to the rootfs shell prompt. printk_s holds the
+kernel's own timestamp of each marker line that carried one (printk.time=1
+in boot.cmd), as a cross-check of the host-side clock: printk_s["init"] is
+how long the kernel itself took to reach /init. unpack_s is the time the
+kernel spent unpacking the initramfs, between its "Trying to unpack" and
+"Freeing initrd memory" lines.
+"""
+
+import argparse
+import json
+import os
+import re
+import select
+import signal
+import statistics
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+OUT = os.environ.get('OUT', os.path.join(HERE, 'out'))
+
+# (marker, regex over one console line), in boot order
+MARKERS = [
+    ('u-boot', re.compile(r'^U-Boot \d{4}\.\d\d')),
+    ('starting', re.compile(r'^Starting kernel')),
+    ('linux', re.compile(r'Booting Linux on physical CPU')),
+    # The kernel's own line comes first and carries a printk timestamp
+    ('init', re.compile(r'^(Run /init as init process|\[boot\] init$)')),
+    ('switch_root', re.compile(r'^\[boot\] switch_root$')),
+    ('rcS', re.compile(r'^\[OK\] rcS script started')),
+    ('done', re.compile(r'^\[boot\] rcS done$')),
+    # No newline follows the prompt, so this one is matched on partial lines
+    ('shell', re.compile(r'[#$] $')),
+]
+
+# Stage names; stage i runs from marker i-1 (QEMU start for i = 0) to marker i
+STAGES = ['qemu', 'u-boot', 'decompress', 'kernel', 'initramfs',
+          'switch_root', 'rcS', 'shell']
+
+# Kernel lines timed by printk only, as (start, end) of the initramfs unpack
+UNPACK = (re.compile(r'^Trying to unpack rootfs image as initramfs'),
+          re.compile(r'^Freeing initrd memory'))
+
+PRINTK = re.compile(r'^\[\s*(\d+\.\d+)\]\s*')
+
+
+def qemu_command(args):
+    """Return the QEMU command line for one boot."""
+    return [args.qemu, '-M', 'vexpress-a9', '-m', args.memory,
+            '-kernel', args.uboot,
+            '-drive', f'file={args.sd},format=raw,if=sd',
+            # Boots must not see each other's writes to the image
+            '-snapshot',
+            '-nographic', '-monitor', 'none', '-no-reboot']
+
+
+def match_line(line, now, seen, printk):
+    """Record the first marker LINE matches, if any, at host time NOW."""
+    m = PRINTK.match(line)
+    text = line[m.end():] if m else line
+    if m:
+        for key, regex in zip(('unpack_start', 'unpack_end'), UNPACK):
+            if regex.search(text):
+                printk[key] = float(m.group(1))
+    for name, regex in MARKERS:
+        if name == 'shell' and 'done' not in seen:
+            continue
+        if name not in seen and regex.search(text):
+            seen[name] = now
+            if m:
+                printk[name] = float(m.group(1))
+            return
+
+
+def boot_once(args, log):
+    """Boot once; return ({marker: host_s}, {marker: printk_s}, complete)."""
+    seen, printk = {}, {}
+    start = time.monotonic()
+    proc = subprocess.Popen(qemu_command(args), stdin=subprocess.DEVNULL,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    buf = b''
+    try:
+        # The prompt ends the boot even if an earlier marker never showed up
+        while 'shell' not in seen:
+            left = args.timeout - (time.monotonic() - start)
+            if left <= 0:
+                break
+            ready, _, _ = select.select([proc.stdout], [], [], left)
+            if not ready:
+                break
+            chunk = os.read(proc.stdout.fileno(), 4096)
+            if not chunk:
+                break
+            now = time.monotonic() - start
+            buf += chunk
+            *lines, buf = buf.split(b'\n')
+            for raw in lines:
+                line = raw.decode('utf-8', 'replace').rstrip('\r')
+                if log:
+                    log.write(f'[{now:9.3f}] {line}\n')
+                match_line(line, now, seen, printk)
+            if 'done' in seen and buf:
+                match_line(buf.decode('utf-8', 'replace'), now, seen, printk)
+    finally:
+        proc.send_signal(signal.SIGTERM)
+        try:
+            proc.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+    return seen, printk, 'shell' in seen
+
+
+def split_stages(seen):
+    """Turn marker times into stage durations.
+
+    A stage whose end marker never showed up gets no entry; its time lands
+    in the next stage that does end in a marker.
+    """
+    stages, last = {}, 0.0
+    for (name, _), stage in zip(MARKERS, STAGES):
+        if name in seen:
+            stages[stage] = round(seen[name] - last, 3)
+            last = seen[name]
+    return stages
+
+
+def run_boots(args, out, log=None, label=''):
+    """Boot args.runs times, print a JSON line per run; return complete runs."""
+    results = []
+    for run in range(args.runs):
+        if log:
+            log.write(f'--- {label} run {run}\n')
+        seen, printk, complete = boot_once(args, log)
+        rec = {'run': run, 'complete': complete,
+               'total_s': round(max(seen.values(), default=0.0), 3),
+               'stages': split_stages(seen), 'printk_s': printk}
+        if 'unpack_start' in printk and 'unpack_end' in printk:
+            rec['unpack_s'] = round(printk['unpack_end'] -
+                                    printk['unpack_start'], 6)
+        if label:
+            rec['label'] = label
+        print(json.dumps(rec), file=out, flush=True)
+        if not complete:
+            missing = [name for name, _ in MARKERS if name not in seen]
+            print(f'run {run}: timed out, never saw {", ".join(missing)}',
+                  file=sys.stderr)
+            continue
+        results.append(rec)
+    return results
+
+
+def median_of(results, key):
+    """Median of a top-level field over the runs that have it, or None."""
+    values = [r[key] for r in results if key in r]
+    return statistics.median(values) if values else None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[0].strip())
+    ap.add_argument('--uboot', default=os.path.join(OUT, 'uboot', 'u-boot'),
+                    help='U-Boot ELF (default: %(default)s)')
+    ap.add_argument('--sd', default=os.path.join(OUT, 'sd', 'sd.img'),
+                    help='SD card image (default: %(default)s)')
+    ap.add_argument('--qemu', default='qemu-system-arm')
+    ap.add_argument('--memory', default='512M')
+    ap.add_argument('-n', '--runs', type=int, default=3)
+    ap.add_argument('--timeout', type=float, default=120,
+                    help='seconds to wait for the shell prompt')
+    ap.add_argument('--label', default='',
+                    help='tag added to every JSON line, e.g. a variant name')
+    ap.add_argument('-o', '--output', help='JSON lines file (default: stdout)')
+    ap.add_argument('--log', help='append console output with timestamps here')
+    args = ap.parse_args()
+
+    for path in (args.uboot, args.sd):
+        if not os.path.exists(path):
+            sys.exit(f'{path} not found; run ./build.sh first')
+
+    out = open(args.output, 'a') if args.output else sys.stdout
+    log = open(args.log, 'a') if args.log else None
+    results = run_boots(args, out, log, args.label)
+    if not results:
+        sys.exit(1)
+
+    print(f'\nmedian of {len(results)} run(s):', file=sys.stderr)
+    for stage in STAGES:
+        times = [r['stages'][stage] for r in results if stage in r['stages']]
+        if times:
+            print(f'  {stage:12s} {statistics.median(times):7.3f} s',
+                  file=sys.stderr)
+    print(f'  {"total":12s} {median_of(results, "total_s"):7.3f} s',
+          file=sys.stderr)
+    unpack = median_of(results, 'unpack_s')
+    if unpack is not None:
+        print(f'  {"(unpack)":12s} {unpack:7.3f} s   initramfs, by printk',
+              file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,466 @@
+#!/bin/bash
+#
+# Reproducible build of the Lab 3 boot chain: U-Boot, kernel, BusyBox,
+# initramfs, root filesystem and the SD card image, i.e. the steps the
+# Readme walks through by hand.
+#
+# Every stage is cached under a hash of what goes into it: its own build
+# function, the versions and config fragments it uses, the overlay files
+# it copies and the keys of the stages it depends on. A rerun only builds
+# what changed. No step needs root; the SD image is put together with
+# sfdisk, mkfs.vfat/mcopy, mke2fs -d and debugfs instead of losetup+mount.
+#
+# Usage: ./build.sh [STAGE...]   build STAGEs and their dependencies (default: sd)
+#        ./build.sh --list       show every stage's cache key and state
+#        ./build.sh clean        drop cache and build trees, keep downloads
+
+# Exit on error
+set -e
+set -o pipefail
+
+# Text colors
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+# Helper function for section headers
+section() {
+    echo -e "\n${BLUE}==== $1 ====${NC}"
+}
+
+die() {
+    echo -e "${RED}$1${NC}" >&2
+    exit 1
+}
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+
+# Versions and settings; all of them can be overridden from the environment
+UBOOT_VERSION="${UBOOT_VERSION:-2022.01}"
+LINUX_VERSION="${LINUX_VERSION:-6.6.30}"
+BUSYBOX_VERSION="${BUSYBOX_VERSION:-1.36.0}"
+UBOOT_URL="${UBOOT_URL:-https://ftp.denx.de/pub/u-boot/u-boot-$UBOOT_VERSION.tar.bz2}"
+LINUX_URL="${LINUX_URL:-https://cdn.kernel.org/pub/linux/kernel/v${LINUX_VERSION%%.*}.x/linux-$LINUX_VERSION.tar.xz}"
+BUSYBOX_URL="${BUSYBOX_URL:-https://busybox.net/downloads/busybox-$BUSYBOX_VERSION.tar.bz2}"
+
+export ARCH=arm
+export CROSS_COMPILE="${CROSS_COMPILE:-arm-linux-gnueabihf-}"
+JOBS="${JOBS:-$(nproc)}"
+INITRAMFS_COMP="${INITRAMFS_COMP:-gzip}"   # none, gzip, lz4 or zstd
+INITRAMFS_INIT="${INITRAMFS_INIT:-shell}"  # shell (BusyBox) or static (init.c)
+SD_MB="${SD_MB:-64}"                       # QEMU wants a power of two
+BOOT_MB="${BOOT_MB:-16}"
+
+# Fixed timestamps and IDs, so equal inputs give byte-identical images
+export SOURCE_DATE_EPOCH="${SOURCE_DATE_EPOCH:-1700000000}"
+export E2FSPROGS_FAKE_TIME="$SOURCE_DATE_EPOCH"
+ROOTFS_UUID="${ROOTFS_UUID:-6c616233-0000-4000-8000-000000000002}"
+DISK_ID=0x4c616233
+
+OUT="${OUT:-$HERE/out}"
+DL="${DL:-$OUT/dl}"
+CACHE="$OUT/cache"
+SRC="$OUT/src"
+BUILD="$OUT/build"
+
+# Stages in build order, and what each one takes the output of
+STAGES="uboot linux busybox initramfs rootfs bootscr sd"
+declare -A DEPS=(
+    [uboot]=""
+    [linux]=""
+    [busybox]=""
+    [initramfs]="uboot linux busybox"
+    [rootfs]="busybox"
+    [bootscr]="uboot"
+    [sd]="linux initramfs rootfs bootscr"
+)
+declare -A KEY NEEDED ELAPSED
+
+# The static init is the whole initramfs; BusyBox is only needed for the shell one
+case "$INITRAMFS_INIT" in
+shell) ;;
+static) DEPS[initramfs]="uboot linux" ;;
+*) die "Unknown INITRAMFS_INIT=$INITRAMFS_INIT (shell, static)" ;;
+esac
+
+require() {
+    local tool
+    for tool in "$@"; do
+        command -v "$tool" >/dev/null || die "$tool not found"
+    done
+}
+
+# Download a tarball once; prints its path
+fetch() {
+    local url="$1" file="$DL/${1##*/}"
+    if [ ! -e "$file" ]; then
+        mkdir -p "$DL"
+        echo "Downloading $url..." >&2
+        curl -fL --retry 3 -o "$file.part" "$url"
+        mv "$file.part" "$file"
+    fi
+    echo "$file"
+}
+
+# Unpack a tarball into $SRC/NAME unless that was done before
+unpack() {
+    local file="$1" dir="$SRC/$2"
+    if [ ! -e "$dir/.unpacked" ]; then
+        echo "Unpacking ${file##*/}..."
+        rm -rf "$dir"
+        mkdir -p "$dir"
+        tar -xf "$file" -C "$dir" --strip-components=1
+        touch "$dir/.unpacked"
+    fi
+}
+
+# Hash of a file or a directory tree (names, modes, link targets, contents)
+hash_path() {
+    if [ -d "$1" ]; then
+        (cd "$1" && find . -printf '%p %m %l\n' | LC_ALL=C sort &&
+            find . -type f -print0 | LC_ALL=C sort -z | xargs -0 -r sha256sum)
+    elif [ -e "$1" ]; then
+        cat "$1"
+    fi | sha256sum | cut -c1-16
+}
+
+# First line of a tool's version output, so a toolchain change rebuilds
+tool_id() {
+    { "$@" 2>&1 || true; } | head -n1
+}
+
+# Set the options of a Kconfig fragment ("CONFIG_X=..." and
+# "# CONFIG_X is not set" lines) in a .config; olddefconfig fixes up the rest
+apply_fragment() {
+    local config="$1" fragment="$2" line sym
+    [ -e "$fragment" ] || return 0
+    while read -r line; do
+        case "$line" in
+        CONFIG_*=*) sym="${line%%=*}" ;;
+        "# CONFIG_"*" is not set") sym="${line#\# }"; sym="${sym%% *}" ;;
+        *) continue ;;
+        esac
+        sed -i -e "/^$sym=/d" -e "/^# $sym is not set\$/d" "$config"
+        echo "$line" >> "$config"
+    done < "$fragment"
+}
+
+# gen_init_cpio list for a staging tree, with everything owned by root
+cpio_list() {
+    local root="$1" type path mode target
+    (cd "$root" && find . -mindepth 1 -printf '%y %P %m %l\n') | LC_ALL=C sort -k2,2 |
+    while read -r type path mode target; do
+        case "$type" in
+        d) echo "dir /$path $mode 0 0" ;;
+        f) echo "file /$path $root/$path $mode 0 0" ;;
+        l) echo "slink /$path $target $mode 0 0" ;;
+        esac
+    done
+}
+
+# Compress stdin to stdout with $INITRAMFS_COMP, on all cores if possible
+compress() {
+    case "$INITRAMFS_COMP" in
+    none) cat ;;
+    gzip)
+        if command -v pigz >/dev/null; then
+            pigz -9 -n -c -p "$JOBS"
+        else
+            gzip -9 -n -c
+        fi ;;
+    # The kernel only unpacks the legacy lz4 frame format
+    lz4) lz4 -l -9 -q -c ;;
+    zstd) zstd -19 -T"$JOBS" -q -c ;;
+    *) die "Unknown INITRAMFS_COMP=$INITRAMFS_COMP (none, gzip, lz4, zstd)" ;;
+    esac
+}
+
+compressor_id() {
+    case "$INITRAMFS_COMP" in
+    gzip) tool_id pigz --version; tool_id gzip --version ;;
+    lz4) tool_id lz4 --version ;;
+    zstd) tool_id zstd --version ;;
+    esac
+}
+
+comp_suffix() {
+    case "$INITRAMFS_COMP" in
+    gzip) echo .gz ;;
+    lz4) echo .lz4 ;;
+    zstd) echo .zst ;;
+    esac
+}
+
+stage_dir() {
+    echo "$CACHE/$1-${KEY[$1]}"
+}
+
+# ---------------------------------------------------------------------------
+# Stages. inputs_X prints everything besides build_X itself and the keys of
+# its dependencies that decides what build_X produces, helpers it calls
+# included; build_X writes its results into $STAGE_OUT.
+
+inputs_uboot() {
+    declare -f apply_fragment
+    echo "$UBOOT_URL"
+    tool_id "${CROSS_COMPILE}gcc" --version
+    hash_path "$HERE/config/uboot.fragment"
+}
+
+build_uboot() {
+    local tarball src="$SRC/u-boot-$UBOOT_VERSION" obj="$BUILD/u-boot-$UBOOT_VERSION"
+    tarball="$(fetch "$UBOOT_URL")"
+    unpack "$tarball" "u-boot-$UBOOT_VERSION"
+    mkdir -p "$obj"
+    make -C "$src" O="$obj" vexpress_ca9x4_defconfig
+    apply_fragment "$obj/.config" "$HERE/config/uboot.fragment"
+    make -C "$src" O="$obj" olddefconfig
+    make -C "$src" O="$obj" -j"$JOBS"
+    cp "$obj/u-boot" "$obj/tools/mkimage" "$STAGE_OUT/"
+}
+
+inputs_linux() {
+    declare -f apply_fragment
+    echo "$LINUX_URL"
+    tool_id "${CROSS_COMPILE}gcc" --version
+    hash_path "$HERE/config/linux.fragment"
+}
+
+build_linux() {
+    local tarball dtb src="$SRC/linux-$LINUX_VERSION" obj="$BUILD/linux-$LINUX_VERSION"
+    tarball="$(fetch "$LINUX_URL")"
+    unpack "$tarball" "linux-$LINUX_VERSION"
+    mkdir -p "$obj"
+    make -C "$src" O="$obj" vexpress_defconfig
+    apply_fragment "$obj/.config" "$HERE/config/linux.fragment"
+    make -C "$src" O="$obj" olddefconfig
+    make -C "$src" O="$obj" -j"$JOBS" zImage dtbs
+    cp "$obj/arch/arm/boot/zImage" "$STAGE_OUT/"
+    # The vexpress device trees moved into dts/arm/ in 6.5
+    for dtb in "$obj"/arch/arm/boot/dts/{arm/,}vexpress-v2p-ca9.dtb; do
+        if [ -e "$dtb" ]; then
+            cp "$dtb" "$STAGE_OUT/vexpress.dtb"
+            break
+        fi
+    done
+    [ -e "$STAGE_OUT/vexpress.dtb" ] || die "vexpress-v2p-ca9.dtb was not built"
+    # Host tool that packs the initramfs without root or cpio(1)
+    "${HOSTCC:-cc}" -O2 -o "$STAGE_OUT/gen_init_cpio" "$src/usr/gen_init_cpio.c"
+}
+
+inputs_busybox() {
+    declare -f apply_fragment
+    echo "$BUSYBOX_URL"
+    tool_id "${CROSS_COMPILE}gcc" --version
+    hash_path "$HERE/config/busybox.fragment"
+}
+
+build_busybox() {
+    local tarball src="$SRC/busybox-$BUSYBOX_VERSION" obj="$BUILD/busybox-$BUSYBOX_VERSION"
+    tarball="$(fetch "$BUSYBOX_URL")"
+    unpack "$tarball" "busybox-$BUSYBOX_VERSION"
+    mkdir -p "$obj"
+    make -C "$src" O="$obj" defconfig
+    apply_fragment "$obj/.config" "$HERE/config/busybox.fragment"
+    # BusyBox's Kconfig predates olddefconfig
+    make -C "$src" O="$obj" oldconfig < <(yes "") > /dev/null
+    make -C "$obj" -j"$JOBS"
+    make -C "$obj" CONFIG_PREFIX="$STAGE_OUT/install" install > /dev/null
+}
+
+inputs_initramfs() {
+    declare -f cpio_list compress comp_suffix
+    echo "$INITRAMFS_COMP $INITRAMFS_INIT"
+    compressor_id
+    if [ "$INITRAMFS_INIT" = static ]; then
+        tool_id "${CROSS_COMPILE}gcc" --version
+        hash_path "$HERE/init.c"
+    else
+        hash_path "$HERE/overlay/initramfs"
+    fi
+}
+
+build_initramfs() {
+    local stage="$STAGE_OUT/stage" cpio="$STAGE_OUT/initramfs.cpio"
+    mkdir -p "$stage"/{proc,sys,dev,newroot}
+    if [ "$INITRAMFS_INIT" = static ]; then
+        "${CROSS_COMPILE}gcc" -static -Os -s -Wall -o "$stage/init" "$HERE/init.c"
+    else
+        cp -a "$(stage_dir busybox)/install/." "$HERE/overlay/initramfs/." "$stage/"
+    fi
+    cpio_list "$stage" > "$STAGE_OUT/initramfs.list"
+    # /init's output goes nowhere without a console node
+    echo "nod /dev/console 0600 0 0 c 5 1" >> "$STAGE_OUT/initramfs.list"
+    "$(stage_dir linux)/gen_init_cpio" -t "$SOURCE_DATE_EPOCH" "$STAGE_OUT/initramfs.list" > "$cpio"
+    if [ "$INITRAMFS_COMP" != none ]; then
+        compress < "$cpio" > "$cpio$(comp_suffix)"
+    fi
+    # U-Boot only passes the ramdisk on; the kernel does the decompression
+    "$(stage_dir uboot)/mkimage" -A arm -O linux -T ramdisk -C none -n "Initramfs" \
+        -d "$cpio$(comp_suffix)" "$STAGE_OUT/uInitrd" > /dev/null
+    rm -rf "$stage"
+}
+
+inputs_rootfs() {
+    echo "$SD_MB $BOOT_MB $ROOTFS_UUID $SOURCE_DATE_EPOCH"
+    tool_id mke2fs -V
+    hash_path "$HERE/overlay/rootfs"
+}
+
+build_rootfs() {
+    local stage="$STAGE_OUT/stage" image="$STAGE_OUT/rootfs.ext4"
+    require mke2fs debugfs
+    mkdir -p "$stage"/{bin,sbin,etc,proc,sys,usr/bin,usr/sbin,dev,tmp,home}
+    cp -a "$(stage_dir busybox)/install/." "$HERE/overlay/rootfs/." "$stage/"
+    find "$stage" -exec touch -h -d "@$SOURCE_DATE_EPOCH" {} +
+    mke2fs -q -t ext4 -L ROOT -U "$ROOTFS_UUID" -E "hash_seed=$ROOTFS_UUID" \
+        -d "$stage" "$image" "$((SD_MB - 1 - BOOT_MB))M"
+    # mke2fs -d keeps the builder's uid and the files' real ctime, and
+    # mknod needs root: fix all of that up inside the image instead
+    {
+        (cd "$stage" && find . -printf '%P\n') | while read -r path; do
+            echo "sif /$path uid 0"
+            echo "sif /$path gid 0"
+            echo "sif /$path ctime @$SOURCE_DATE_EPOCH"
+        done
+        # debugfs links new nodes into its cwd under the name given
+        echo "cd /dev"
+        echo "mknod console c 5 1"
+        echo "sif console mode 020666"
+        echo "mknod null c 1 3"
+        echo "sif null mode 020666"
+    } | debugfs -w -f - "$image" > "$STAGE_OUT/debugfs.log" 2>&1
+    # debugfs exits 0 when a command fails; anything besides its banner,
+    # the echoed commands and mknod's inode numbers is an error message
+    if grep -Ev '^(debugfs[ :]|Allocated inode: )' "$STAGE_OUT/debugfs.log" >&2; then
+        die "debugfs could not fix up $image"
+    fi
+    debugfs -R "stat /dev/console" "$image" 2>/dev/null |
+        grep -q "Type: character special" || die "/dev/console missing from $image"
+    rm -rf "$stage" "$STAGE_OUT/debugfs.log"
+}
+
+inputs_bootscr() {
+    hash_path "$HERE/boot.cmd"
+}
+
+build_bootscr() {
+    "$(stage_dir uboot)/mkimage" -A arm -O linux -T script -C none -n "Boot script" \
+        -d "$HERE/boot.cmd" "$STAGE_OUT/boot.scr" > /dev/null
+}
+
+inputs_sd() {
+    echo "$SD_MB $BOOT_MB $DISK_ID"
+    tool_id mkfs.vfat --help
+    tool_id mcopy --version
+}
+
+build_sd() {
+    local boot="$STAGE_OUT/boot.vfat" image="$STAGE_OUT/sd.img"
+    require sfdisk mkfs.vfat mcopy
+    mkfs.vfat -n BOOT -i "${DISK_ID#0x}" -C "$boot" $((BOOT_MB * 1024)) > /dev/null
+    MTOOLS_SKIP_CHECK=1 mcopy -m -i "$boot" \
+        "$(stage_dir linux)/zImage" "$(stage_dir linux)/vexpress.dtb" \
+        "$(stage_dir initramfs)/uInitrd" "$(stage_dir bootscr)/boot.scr" ::/
+    # Same layout as the fdisk session in the Readme: a FAT boot partition
+    # at 1M, then ext4 for the rest of the card
+    truncate -s "${SD_MB}M" "$image"
+    sfdisk -q "$image" <<EOF
+label: dos
+label-id: $DISK_ID
+start=2048, size=$((BOOT_MB * 2048)), type=c, bootable
+start=$(((1 + BOOT_MB) * 2048)), type=83
+EOF
+    dd if="$boot" of="$image" bs=1M seek=1 conv=notrunc status=none
+    dd if="$(stage_dir rootfs)/rootfs.ext4" of="$image" bs=1M seek=$((1 + BOOT_MB)) \
+        conv=notrunc status=none
+    rm -f "$boot"
+}
+
+# ---------------------------------------------------------------------------
+
+compute_keys() {
+    local name dep
+    for name in $STAGES; do
+        KEY[$name]="$({
+            declare -f "build_$name"
+            "inputs_$name"
+            for dep in ${DEPS[$name]}; do
+                echo "$dep ${KEY[$dep]}"
+            done
+        } | sha256sum | cut -c1-16)"
+    done
+}
+
+need() {
+    local dep
+    [ -n "${DEPS[$1]+set}" ] || die "Unknown stage $1 (stages: $STAGES)"
+    NEEDED[$1]=1
+    for dep in ${DEPS[$1]}; do
+        need "$dep"
+    done
+}
+
+# Build one stage into a temporary directory and move it into the cache
+# only once it succeeded, so an interrupted build never looks cached
+run_stage() {
+    local name="$1" dir start
+    dir="$(stage_dir "$name")"
+    if [ -e "$dir/.done" ]; then
+        echo -e "${GREEN}[cached]${NC} $name ${KEY[$name]}"
+        ELAPSED[$name]=cached
+    else
+        section "Building $name (${KEY[$name]})"
+        rm -rf "$dir.tmp"
+        mkdir -p "$dir.tmp"
+        start=$(date +%s)
+        (STAGE_OUT="$dir.tmp"; "build_$name")
+        touch "$dir.tmp/.done"
+        mv "$dir.tmp" "$dir"
+        ELAPSED[$name]="$(($(date +%s) - start))s"
+    fi
+    ln -sfn "$dir" "$OUT/$name"
+}
+
+case "$1" in
+clean)
+    section "Removing cache and build trees"
+    rm -rf "$CACHE" "$BUILD" "$SRC"
+    for name in $STAGES; do
+        rm -f "$OUT/$name"
+    done
+    exit 0
+    ;;
+--list)
+    compute_keys
+    for name in $STAGES; do
+        state=missing
+        [ -e "$CACHE/$name-${KEY[$name]}/.done" ] && state=cached
+        printf '%-10s %s  %s\n' "$name" "${KEY[$name]}" "$state"
+    done
+    exit 0
+    ;;
+-h|--help)
+    sed -n '3,15p' "$0" | sed 's/^# \{0,1\}//'
+    exit 0
+    ;;
+esac
+
+compute_keys
+for target in "${@:-sd}"; do
+    need "$target"
+done
+mkdir -p "$CACHE"
+for name in $STAGES; do
+    [ -n "${NEEDED[$name]}" ] && run_stage "$name"
+done
+
+section "Summary"
+for name in $STAGES; do
+    [ -n "${NEEDED[$name]}" ] && printf '%-10s %s  %s\n' "$name" "${KEY[$name]}" "${ELAPSED[$name]}"
+done
+echo -e "${GREEN}Outputs are linked from $OUT/<stage>; boot with:${NC}"
+echo "  $HERE/boot_profile.py   (or qemu-system-arm -M vexpress-a9 -m 512M -kernel $OUT/uboot/u-boot \\"
+echo "      -drive file=$OUT/sd/sd.img,format=raw,if=sd -nographic)"
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Lab 3 initramfs variant comparison
+
+Builds the SD image once per initramfs variant with build.sh, i.e. per
+compressor (none, gzip, lz4, zstd) and /init (the BusyBox shell script or
+the static init.c), then boots each in QEMU with boot_profile.py. Stages
+the variants share come from build.sh's cache, so only the initramfs and
+the SD image are rebuilt per variant.
+
+One JSON line per variant goes to stdout, a table sorted by time to the
+rootfs shell to stderr:
+
+  {"variant": "lz4/static", "cpio_bytes": 700416, "image_bytes": 391270,
+   "unpack_s": 0.0061, "init_s": 1.102, "shell_s": 3.875, "runs": 3}
+
+image_bytes is the uInitrd U-Boot loads, unpack_s the kernel's own
+(printk) time for unpacking it: together they are the size-versus-
+decompression-speed trade-off on the target. init_s is the printk time at
+which /init started, shell_s the host time to the shell prompt.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+import boot_profile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BUILD = os.path.join(HERE, 'build.sh')
+
+
+def build_variant(comp, init):
+    """Build the SD image for one variant; return its stage directories."""
+    env = dict(os.environ, INITRAMFS_COMP=comp, INITRAMFS_INIT=init)
+    # Build output goes to stderr, stdout is for the results
+    subprocess.run([BUILD, 'sd'], env=env, check=True, stdout=sys.stderr)
+    return {stage: os.path.realpath(os.path.join(boot_profile.OUT, stage))
+            for stage in ('uboot', 'initramfs', 'sd')}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[0].strip())
+    ap.add_argument('--comp', default='none,gzip,lz4,zstd',
+                    help='compressors to try (default: %(default)s)')
+    ap.add_argument('--init', default='shell,static',
+                    help='/init flavours to try (default: %(default)s)')
+    ap.add_argument('-n', '--runs', type=int, default=3,
+                    help='boots per variant; medians are reported')
+    ap.add_argument('--qemu', default='qemu-system-arm')
+    ap.add_argument('--memory', default='512M')
+    ap.add_argument('--timeout', type=float, default=120)
+    ap.add_argument('--raw', help='append every boot as a JSON line here')
+    ap.add_argument('--log', help='append console output with timestamps here')
+    args = ap.parse_args()
+
+    raw = open(args.raw, 'a') if args.raw else open(os.devnull, 'w')
+    log = open(args.log, 'a') if args.log else None
+    rows = []
+    for init in args.init.split(','):
+        for comp in args.comp.split(','):
+            variant = f'{comp}/{init}'
+            print(f'==== {variant} ====', file=sys.stderr)
+            dirs = build_variant(comp, init)
+            boot = argparse.Namespace(
+                qemu=args.qemu, memory=args.memory, runs=args.runs,
+                timeout=args.timeout,
+                uboot=os.path.join(dirs['uboot'], 'u-boot'),
+                sd=os.path.join(dirs['sd'], 'sd.img'))
+            results = boot_profile.run_boots(boot, raw, log, variant)
+            row = {
+                'variant': variant,
+                'cpio_bytes': os.path.getsize(
+                    os.path.join(dirs['initramfs'], 'initramfs.cpio')),
+                'image_bytes': os.path.getsize(
+                    os.path.join(dirs['initramfs'], 'uInitrd')),
+                'unpack_s': boot_profile.median_of(results, 'unpack_s'),
+                'init_s': boot_profile.median_of(
+                    [r['printk_s'] for r in results], 'init'),
+                'shell_s': boot_profile.median_of(results, 'total_s'),
+                'runs': len(results),
+            }
+            print(json.dumps(row), flush=True)
+            rows.append(row)
+
+    def fmt(value, scale=1.0, spec='7.3f'):
+        return f'{value * scale:{spec}}' if value is not None else '      -'
+
+    rows.sort(key=lambda r: (r['shell_s'] is None, r['shell_s'] or 0))
+    print(f'\n{"variant":14s} {"cpio KiB":>8s} {"image KiB":>9s} '
+          f'{"unpack ms":>9s} {"/init s":>7s} {"shell s":>7s}', file=sys.stderr)
+    for r in rows:
+        print(f'{r["variant"]:14s} {r["cpio_bytes"] / 1024:8.0f} '
+              f'{r["image_bytes"] / 1024:9.0f} '
+              f'{fmt(r["unpack_s"], 1000, "9.1f")} {fmt(r["init_s"])} '
+              f'{fmt(r["shell_s"])}', file=sys.stderr)
+    if rows and rows[0]['shell_s'] is not None:
+        print(f'\nfastest to the rootfs shell: {rows[0]["variant"]}',
+              file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,107 @@
+/*
+ * Minimal /init for the Lab 3 initramfs (build.sh INITRAMFS_INIT=static).
+ *
+ * Does what overlay/initramfs/init does - mount proc, sysfs and devtmpfs,
+ * mount the SD card's root partition and switch_root to it - without a
+ * shell or BusyBox, so the initramfs is this one static binary. It prints
+ * the same [boot] markers for boot_profile.py.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ROOT_DEV	"/dev/mmcblk0p2"
+#define ROOT_FSTYPE	"ext4"
+#define NEW_ROOT	"/newroot"
+#define REAL_INIT	"/sbin/init"
+
+/* The MMC host probes asynchronously; give the card this long to show up */
+#define ROOT_WAIT_MS	5000
+#define ROOT_POLL_MS	10
+
+static void say(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	fflush(stdout);
+}
+
+static void mount_or_warn(const char *src, const char *dst, const char *type)
+{
+	if (mount(src, dst, type, 0, NULL) < 0)
+		say("init: mount %s on %s: %s\n", type, dst, strerror(errno));
+}
+
+static int mount_root(void)
+{
+	struct timespec poll = { 0, ROOT_POLL_MS * 1000000L };
+	int waited;
+
+	mkdir(NEW_ROOT, 0755);
+	for (waited = 0; waited < ROOT_WAIT_MS; waited += ROOT_POLL_MS) {
+		if (mount(ROOT_DEV, NEW_ROOT, ROOT_FSTYPE, 0, NULL) == 0)
+			return 0;
+		if (errno != ENOENT && errno != ENXIO && errno != ENODEV)
+			break;
+		nanosleep(&poll, NULL);
+	}
+	say("init: mount %s on %s: %s\n", ROOT_DEV, NEW_ROOT, strerror(errno));
+	return -1;
+}
+
+/*
+ * switch_root(8): carry the pseudo filesystems over, drop the initramfs'
+ * only file to give its memory back, and make the new root "/".
+ */
+static int switch_root(void)
+{
+	static const char *const moved[] = { "/dev", "/proc", "/sys" };
+	char target[64];
+	size_t i;
+
+	for (i = 0; i < sizeof(moved) / sizeof(moved[0]); i++) {
+		snprintf(target, sizeof(target), NEW_ROOT "%s", moved[i]);
+		if (mount(moved[i], target, NULL, MS_MOVE, NULL) < 0)
+			umount2(moved[i], MNT_DETACH);
+	}
+
+	if (chdir(NEW_ROOT) < 0)
+		return -1;
+	unlink("/init");
+	if (mount(".", "/", NULL, MS_MOVE, NULL) < 0 || chroot(".") < 0 ||
+	    chdir("/") < 0)
+		return -1;
+	return 0;
+}
+
+int main(void)
+{
+	char *const argv[] = { REAL_INIT, NULL };
+
+	say("[boot] init\n");
+	mount_or_warn("none", "/proc", "proc");
+	mount_or_warn("none", "/sys", "sysfs");
+	mount_or_warn("none", "/dev", "devtmpfs");
+
+	if (mount_root() < 0)
+		return 1;
+
+	say("[boot] switch_root\n");
+	if (switch_root() < 0) {
+		say("init: switch_root: %s\n", strerror(errno));
+		return 1;
+	}
+	execv(REAL_INIT, argv);
+	say("init: exec %s: %s\n", REAL_INIT, strerror(errno));
+	return 1;
+}
@@ -15,8 +15,23 @@ section() {
     echo -e "\n${BLUE}==== $1 ====${NC}"
 }
 
+# Stack contents are saved here for setup.sh to restore
+CHECKPOINT="${INT_STACK_CHECKPOINT:-/var/tmp/int_stack.ckpt}"
+
 section "Cleanup started"
 
+section "Saving stack contents"
+if [ -e /dev/int_stack ] && [ -x ./kernel_stack ]; then
+    sudo ./kernel_stack checkpoint "$CHECKPOINT"
+    if [ $? -eq 0 ]; then
+        echo -e "${GREEN}Success:${NC} setup.sh will restore it from $CHECKPOINT"
+    else
+        echo -e "${RED}Warning:${NC} Failed to save stack contents, they will be lost"
+    fi
+else
+    echo -e "${YELLOW}Device file or kernel_stack not found, skipping${NC}"
+fi
+
 section "Checking for device file"
 if [ -e /dev/int_stack ]; then
     echo "Removing device file /dev/int_stack"
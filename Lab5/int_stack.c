@@ -4,33 +4,165 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/kernel.h>
+#include <linux/version.h>
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
-#include <linux/rwsem.h>
+#include <linux/spinlock.h>
 #include <linux/ioctl.h>
 #include <linux/device.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/mm.h>
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/list.h>
+#include <linux/crc32.h>
+#include <linux/string.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#include <linux/io_uring/cmd.h>
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#include <linux/io_uring.h>
+#endif
+
+#include "int_stack.h"
+#include "int_stack_ioctl.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Mohammad Anas Alatasi");
 MODULE_DESCRIPTION("Integer stack character device");
-MODULE_VERSION("1.2");
+MODULE_VERSION("1.9");
 
 /* Character device definitions */
 #define DEVICE_NAME        "int_stack"
 #define SUCCESS            0
 #define DEFAULT_STACK_SIZE 10
-#define INT_STACK_MAGIC    'S'
-#define SET_STACK_SIZE     _IOW(INT_STACK_MAGIC, 1, unsigned int)
+#define SNAPSHOT_RETRIES   4      /* lockless attempts before taking the lock */
+#define BATCH_CHUNK        64     /* values per lock hold in sleeping batches */
+
+/*
+ * io_uring passthrough needs .uring_cmd (5.19); pops that wait for data
+ * need cancelation support (6.7) so a dying ring can take them back.
+ */
+#define HAVE_URING_CMD     (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0))
+#define HAVE_URING_WAIT    (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0))
+
+/* Delay after the last push/pop before unused chunks are given back */
+static unsigned int trim_delay_ms = 5000;
+module_param(trim_delay_ms, uint, 0644);
+MODULE_PARM_DESC(trim_delay_ms, "Idle time before unused stack memory is freed, 0 = only under memory pressure (default 5000)");
+
+/* Blob stack limits; the object size is fixed when the cache is created */
+static unsigned int blob_max_size = 4096;
+module_param(blob_max_size, uint, 0444);
+MODULE_PARM_DESC(blob_max_size, "Largest blob in bytes (default 4096)");
+
+static unsigned int blob_max_count = 1024;
+module_param(blob_max_count, uint, 0644);
+MODULE_PARM_DESC(blob_max_count, "Most blobs on the blob stack (default 1024)");
+
+static unsigned long blob_max_bytes = 4 << 20;
+module_param(blob_max_bytes, ulong, 0644);
+MODULE_PARM_DESC(blob_max_bytes, "Most payload bytes on the blob stack (default 4 MiB)");
+
+/* NUMA placement, fixed at load time; SET_NUMA_NODE moves an unsharded stack */
+static int numa_node = NUMA_NO_NODE;
+module_param(numa_node, int, 0444);
+MODULE_PARM_DESC(numa_node, "Node for the int stack's memory, -1 = wherever it is first used (default -1)");
+
+static bool numa_shards;
+module_param(numa_shards, bool, 0444);
+MODULE_PARM_DESC(numa_shards, "Give each NUMA node its own segment of the int stack (default off)");
+
+/*
+ * Values are stored in page-sized chunks allocated as the stack grows, so
+ * a stack resized for a rare peak only costs what it actually holds.
+ * Chunks [0, nr_chunks) are allocated and the rest are NULL; unused tail
+ * chunks are freed after an idle period or by the shrinker.
+ */
+struct int_stack_chunk {
+    struct rcu_head    rcu;
+    int                nid;       /* node the chunk's memory is on */
+    int                v[];
+};
+
+#define CHUNK_BYTES        PAGE_SIZE
+#define CHUNK_INTS         ((unsigned int)((CHUNK_BYTES - \
+                            offsetof(struct int_stack_chunk, v)) / sizeof(int)))
+
+/* Chunk directory, replaced as a whole by stack_resize() */
+struct int_stack_data {
+    unsigned int       cap;       /* capacity in elements, for lockless readers */
+    unsigned int       nchunks;   /* DIV_ROUND_UP(cap, CHUNK_INTS) */
+    struct int_stack_chunk __rcu *chunk[];
+};
+
+/*
+ * One element of the blob stack. Objects come from blob_cache, sized for
+ * blob_max_size, so pushes and pops skip the general kmalloc buckets.
+ */
+struct int_stack_blob {
+    struct int_stack_blob *next;  /* element below */
+    unsigned int       len;
+    u8                 data[];
+};
+
+/*
+ * A segment of the int stack with its own lock. Unsharded, the stack is a
+ * single segment; with numa_shards there is one per node, each a LIFO of
+ * its own, so pushers and poppers on different nodes never share a lock
+ * or a cache line.
+ */
+struct int_stack_shard {
+    struct int_stack_data __rcu *data; /* replaced on resize, freed after RCU */
+    unsigned int       size;      /* current # elements */
+    unsigned int       max_size;  /* capacity; off target after a resize lent some */
+    unsigned int       target;    /* this shard's share of the stack's capacity */
+    unsigned int       nr_chunks; /* chunks allocated */
+    int                node;      /* where memory comes from, or NUMA_NO_NODE */
+    unsigned long      last_used; /* jiffies of the last push/pop */
+    unsigned long      local_hits;  /* values moved by a CPU on the chunk's node */
+    unsigned long      remote_hits; /* values moved by a CPU on another node */
+    spinlock_t         lock;      /* protects the fields above, irq-safe */
+    seqcount_spinlock_t seq;      /* bumped by writers, for snapshot readers */
+} ____cacheline_aligned_in_smp;
 
 /* Stack data structure */
 struct int_stack {
-    int               *data;
-    unsigned int       size;      /* current # elements */
-    unsigned int       max_size;  /* capacity */
-    struct rw_semaphore rwsem;    /* for concurrency */
+    unsigned int       max_size;  /* capacity, split evenly across the shards */
+    atomic_t           spare;     /* capacity borrowers gave back, for lenders */
+    struct mutex       resize_lock; /* serializes stack_resize() and node moves */
+    struct delayed_work trim_work; /* frees unused chunks once idle */
+    struct list_head   uring_waiters; /* io_uring pops waiting for data */
+    unsigned int       nr_waiters; /* length of uring_waiters */
+    spinlock_t         waiters_lock; /* protects the two above, irq-safe */
+
+    /* Blob stack, independent of the int stack */
+    struct int_stack_blob *blobs; /* top, or NULL */
+    unsigned int       nr_blobs;
+    unsigned long      blob_bytes; /* payload bytes held */
+    spinlock_t         blob_lock; /* protects the blob fields */
+
+    unsigned int       nr_shards; /* 1, or nr_node_ids with numa_shards */
+    struct int_stack_shard *shard[]; /* indexed by node when sharded */
+};
+
+/* Per-open state */
+struct int_stack_file {
+    unsigned int       read_mode; /* INT_STACK_READ_* */
+    unsigned int       elem_mode; /* INT_STACK_ELEM_* */
+    int               *snap;      /* snapshot being read, or NULL */
+    size_t             snap_bytes;
+    struct mutex       lock;      /* protects the fields above */
 };
 
 /* File‐ops prototypes */
@@ -39,6 +171,13 @@ static int     device_release(struct inode *, struct file *);
 static ssize_t device_read(struct file *, char __user *, size_t, loff_t *);
 static ssize_t device_write(struct file *, const char __user *, size_t, loff_t *);
 static long    device_ioctl(struct file *, unsigned int, unsigned long);
+static loff_t  device_llseek(struct file *, loff_t, int);
+#if HAVE_URING_CMD
+static int     device_uring_cmd(struct io_uring_cmd *, unsigned int);
+#endif
+
+/* Hands pushed values to waiting io_uring pops */
+static void    uring_feed_waiters(struct int_stack *);
 
 /* File‐ops table */
 static struct file_operations fops = {
@@ -47,6 +186,10 @@ static struct file_operations fops = {
     .read           = device_read,
     .write          = device_write,
     .unlocked_ioctl = device_ioctl,
+    .llseek         = device_llseek,
+#if HAVE_URING_CMD
+    .uring_cmd      = device_uring_cmd,
+#endif
 };
 
 /* In‐kernel stack pointer */
@@ -59,94 +202,1418 @@ static int major_number;
 static struct class  *int_stack_class;
 static struct device *int_stack_device;
 
+/* Objects for the blob stack */
+static struct kmem_cache *blob_cache;
+
 /* —— Stack management —— */
 
+/*
+ * Writers hold the shard's lock with interrupts disabled, so push and pop
+ * work from any context, and wrap every change in a seqcount write section
+ * so stack_snapshot() can copy a shard without the lock. Resizing is
+ * serialized by resize_lock and takes the shard lock just for the swap.
+ */
+static inline struct int_stack_data *shard_data(struct int_stack_shard *sh)
+{
+    return rcu_dereference_protected(sh->data,
+                                     lockdep_is_held(&sh->lock) ||
+                                     lockdep_is_held(&stack->resize_lock));
+}
+
+static inline struct int_stack_chunk *shard_chunk(struct int_stack_shard *sh,
+                                                  struct int_stack_data *d,
+                                                  unsigned int idx)
+{
+    return rcu_dereference_protected(d->chunk[idx],
+                                     lockdep_is_held(&sh->lock));
+}
+
+/* Chunks needed to hold the current contents; also read without the lock */
+static inline unsigned int shard_chunks_used(struct int_stack_shard *sh)
+{
+    return DIV_ROUND_UP(READ_ONCE(sh->size), CHUNK_INTS);
+}
+
+/*
+ * Share of shard i when the whole stack holds max_size. Each shard's
+ * directory covers the whole capacity, so a resize never has to drop
+ * values that still fit the stack: a shard holding more than its new
+ * share borrows the room other shards are not using (see
+ * stack_plan_shares()) and gives it back as it is popped.
+ */
+static inline unsigned int shard_cap(struct int_stack *s,
+                                     unsigned int max_size, unsigned int i)
+{
+    return max_size / s->nr_shards + (i < max_size % s->nr_shards);
+}
+
+/* The shard to try first: the current CPU's node when sharded */
+static inline unsigned int stack_local_shard(struct int_stack *s)
+{
+    return s->nr_shards > 1 ? numa_node_id() : 0;
+}
+
+/* Number of ints on the stack; a racy sum when sharded */
+static unsigned int stack_size(struct int_stack *s)
+{
+    unsigned int i, n = 0;
+    for (i = 0; i < s->nr_shards; i++)
+        n += READ_ONCE(s->shard[i]->size);
+    return n;
+}
+
+static inline int chunk_nid(const struct int_stack_chunk *c)
+{
+    return page_to_nid(virt_to_page(c));
+}
+
+/* Count n values moved through c as node-local or remote; lock held */
+static inline void shard_account(struct int_stack_shard *sh,
+                                 const struct int_stack_chunk *c,
+                                 unsigned int n)
+{
+    if (c->nid == numa_node_id())
+        sh->local_hits += n;
+    else
+        sh->remote_hits += n;
+}
+
+static struct int_stack_data *stack_alloc_data(unsigned int cap, int node)
+{
+    unsigned int nchunks = DIV_ROUND_UP(cap, CHUNK_INTS);
+    struct int_stack_data *d;
+
+    d = kvzalloc_node(struct_size(d, chunk, nchunks), GFP_KERNEL_ACCOUNT,
+                      node);
+    if (d) {
+        d->cap     = cap;
+        d->nchunks = nchunks;
+    }
+    return d;
+}
+
+static struct int_stack_shard *shard_alloc(unsigned int max_size,
+                                           unsigned int target, int node)
+{
+    struct int_stack_shard *sh = kzalloc_node(sizeof(*sh), GFP_KERNEL, node);
+    struct int_stack_data *data;
+    if (!sh)
+        return NULL;
+    data = stack_alloc_data(max_size, node);
+    if (!data) {
+        kfree(sh);
+        return NULL;
+    }
+    RCU_INIT_POINTER(sh->data, data);
+    sh->max_size  = target;
+    sh->target    = target;
+    sh->node      = node;
+    sh->last_used = jiffies;
+    spin_lock_init(&sh->lock);
+    seqcount_spinlock_init(&sh->seq, &sh->lock);
+    return sh;
+}
+
+static void shard_free(struct int_stack_shard *sh)
+{
+    /* No file is open any more, so nobody can be reading the chunks */
+    struct int_stack_data *data = rcu_dereference_protected(sh->data, 1);
+    unsigned int i;
+    for (i = 0; i < sh->nr_chunks; i++)
+        kfree(rcu_dereference_protected(data->chunk[i], 1));
+    kvfree(data);
+    kfree(sh);
+}
+
+static void stack_deinit(struct int_stack *s)
+{
+    unsigned int i;
+    if (!s)
+        return;
+    for (i = 0; i < s->nr_shards; i++) {
+        if (s->shard[i])
+            shard_free(s->shard[i]);
+        s->shard[i] = NULL;
+    }
+    s->max_size = 0;
+    printk(KERN_INFO "int_stack: Deinitialized\n");
+}
+
+/* s->nr_shards must be set; the shards are allocated here */
 static int stack_init(struct int_stack *s, unsigned int max_size)
 {
+    unsigned int i;
+    int node;
     if (!s)
         return -EINVAL;
-    s->data = kmalloc(sizeof(int) * max_size, GFP_KERNEL);
-    if (!s->data)
-        return -ENOMEM;
-    s->size     = 0;
     s->max_size = max_size;
-    init_rwsem(&s->rwsem);
-    printk(KERN_INFO "int_stack: Initialized with capacity %u\n", max_size);
+    atomic_set(&s->spare, 0);
+    mutex_init(&s->resize_lock);
+    INIT_LIST_HEAD(&s->uring_waiters);
+    s->nr_waiters = 0;
+    spin_lock_init(&s->waiters_lock);
+    s->blobs      = NULL;
+    s->nr_blobs   = 0;
+    s->blob_bytes = 0;
+    spin_lock_init(&s->blob_lock);
+    for (i = 0; i < s->nr_shards; i++) {
+        /* A shard for a node that is not online takes memory from anywhere */
+        if (s->nr_shards > 1)
+            node = node_online(i) ? i : NUMA_NO_NODE;
+        else
+            node = numa_node;
+        s->shard[i] = shard_alloc(max_size, shard_cap(s, max_size, i), node);
+        if (!s->shard[i]) {
+            stack_deinit(s);
+            return -ENOMEM;
+        }
+    }
+    printk(KERN_INFO "int_stack: Initialized with capacity %u in %u shard(s)\n",
+           max_size, s->nr_shards);
     return SUCCESS;
 }
 
-static void stack_deinit(struct int_stack *s)
+/*
+ * Allocate the next chunk from atomic context, or take *spare if the
+ * caller preallocated one with a sleeping allocation.
+ */
+static struct int_stack_chunk *stack_chunk_alloc(struct int_stack_shard *sh,
+                                                 struct int_stack_chunk **spare)
 {
-    if (s && s->data) {
-        kfree(s->data);
-        s->data = NULL;
-        s->size = s->max_size = 0;
-        printk(KERN_INFO "int_stack: Deinitialized\n");
+    struct int_stack_chunk *c = *spare;
+    if (c)
+        *spare = NULL;
+    else
+        c = kmalloc_node(CHUNK_BYTES, GFP_NOWAIT | __GFP_ACCOUNT | __GFP_NOWARN,
+                         sh->node);
+    if (c)
+        c->nid = chunk_nid(c);
+    return c;
+}
+
+/*
+ * Push as many of values[0..n) as fit; returns the number pushed. Stops
+ * early if a new chunk is needed and cannot be allocated.
+ */
+static unsigned int shard_push_many(struct int_stack_shard *sh,
+                                    const int *values, unsigned int n,
+                                    struct int_stack_chunk **spare)
+{
+    struct int_stack_data *d = shard_data(sh);
+    struct int_stack_chunk *c;
+    unsigned int done = 0, idx, off, k;
+
+    n = min(n, sh->max_size - sh->size);
+    if (!n)
+        return 0;
+    write_seqcount_begin(&sh->seq);
+    while (done < n) {
+        idx = sh->size / CHUNK_INTS;
+        off = sh->size % CHUNK_INTS;
+        if (idx == sh->nr_chunks) {
+            c = stack_chunk_alloc(sh, spare);
+            if (!c)
+                break;
+            rcu_assign_pointer(d->chunk[idx], c);
+            sh->nr_chunks++;
+        } else {
+            c = shard_chunk(sh, d, idx);
+        }
+        k = min(n - done, CHUNK_INTS - off);
+        memcpy(c->v + off, values + done, sizeof(int) * k);
+        shard_account(sh, c, k);
+        sh->size += k;
+        done     += k;
     }
+    write_seqcount_end(&sh->seq);
+    sh->last_used = jiffies;
+    return done;
 }
 
-static int stack_push(struct int_stack *s, int value)
+/*
+ * Give capacity a resize lent this shard beyond its share back to the
+ * shards it came from, via s->spare; lock held
+ */
+static inline void shard_settle(struct int_stack *s, struct int_stack_shard *sh)
 {
-    if (!s || !s->data)
-        return -EINVAL;
-    if (s->size >= s->max_size) {
-        printk(KERN_WARNING "int_stack: Overflow, cannot push %d\n", value);
-        return -ERANGE;
+    unsigned int keep;
+
+    if (sh->max_size > sh->target) {
+        keep = max(sh->target, sh->size);
+        atomic_add(sh->max_size - keep, &s->spare);
+        sh->max_size = keep;
     }
-    s->data[s->size++] = value;
-    printk(KERN_DEBUG "int_stack: Pushed %d (size=%u)\n", value, s->size);
-    return SUCCESS;
 }
 
-static int stack_pop(struct int_stack *s, int *value)
+/* Take back capacity this shard lent in a resize, as far as it is free */
+static inline void shard_reclaim(struct int_stack *s, struct int_stack_shard *sh)
 {
-    if (!s || !s->data)
-        return -EINVAL;
-    if (s->size == 0) {
-        printk(KERN_WARNING "int_stack: Underflow\n");
-        return -1;
+    int old = atomic_read(&s->spare), take;
+
+    do {
+        take = min_t(int, old, sh->target - sh->max_size);
+        if (take <= 0)
+            return;
+    } while (!atomic_try_cmpxchg(&s->spare, &old, old - take));
+    sh->max_size += take;
+}
+
+/* Pop up to n values, top first; returns the number popped */
+static unsigned int shard_pop_many(struct int_stack *s,
+                                   struct int_stack_shard *sh, int *values,
+                                   unsigned int n)
+{
+    struct int_stack_data *d = shard_data(sh);
+    struct int_stack_chunk *c;
+    unsigned int i;
+    n = min(n, sh->size);
+    write_seqcount_begin(&sh->seq);
+    for (i = 0; i < n; i++) {
+        sh->size--;
+        c = shard_chunk(sh, d, sh->size / CHUNK_INTS);
+        values[i] = c->v[sh->size % CHUNK_INTS];
+        shard_account(sh, c, 1);
     }
-    *value = s->data[--s->size];
-    printk(KERN_DEBUG "int_stack: Popped %d (size=%u)\n", *value, s->size);
-    return SUCCESS;
+    write_seqcount_end(&sh->seq);
+    shard_settle(s, sh);
+    sh->last_used = jiffies;
+    return n;
+}
+
+/*
+ * Push values[0..n) onto one shard; returns the number pushed, short if
+ * the shard filled up (*full set) or memory ran out. Without
+ * INT_STACK_NOWAIT the values go in BATCH_CHUNK at a time with a
+ * reschedule point in between, and a failed atomic chunk allocation is
+ * retried the sleeping way.
+ */
+static unsigned int shard_push(struct int_stack *s, struct int_stack_shard *sh,
+                               const int *values, unsigned int n,
+                               unsigned int flags, bool *full)
+{
+    struct int_stack_chunk *spare = NULL;
+    unsigned int done = 0, chunk, moved;
+    unsigned long irqflags;
+
+    *full = false;
+    while (done < n) {
+        chunk = n - done;
+        if (!(flags & INT_STACK_NOWAIT))
+            chunk = min(chunk, (unsigned int)BATCH_CHUNK);
+        spin_lock_irqsave(&sh->lock, irqflags);
+        if (sh->size + chunk > sh->max_size && sh->max_size < sh->target)
+            shard_reclaim(s, sh);
+        moved = shard_push_many(sh, values + done, chunk, &spare);
+        *full = sh->size >= sh->max_size;
+        spin_unlock_irqrestore(&sh->lock, irqflags);
+        if (moved)
+            uring_feed_waiters(s);
+        done += moved;
+        if (moved < chunk) {
+            if (*full || (flags & INT_STACK_NOWAIT))
+                break;
+            /* Atomic allocation failed; get a chunk the sleeping way */
+            spare = kmalloc_node(CHUNK_BYTES, GFP_KERNEL_ACCOUNT,
+                                 READ_ONCE(sh->node));
+            if (!spare)
+                break;
+            continue;
+        }
+        if (!(flags & INT_STACK_NOWAIT))
+            cond_resched();
+    }
+    kfree(spare);
+    return done;
+}
+
+/*
+ * Push onto the local shard and spill over to the other nodes once it is
+ * full, so the stack as a whole still holds max_size values. Returns the
+ * number pushed; *full tells a stack that filled up from one that ran out
+ * of memory.
+ */
+static unsigned int stack_push(struct int_stack *s, const int *values,
+                               unsigned int n, unsigned int flags, bool *full)
+{
+    unsigned int i, first = stack_local_shard(s), done = 0;
+
+    *full = false;
+    for (i = 0; i < s->nr_shards && done < n; i++) {
+        done += shard_push(s, s->shard[(first + i) % s->nr_shards],
+                           values + done, n - done, flags, full);
+        if (!*full)
+            break;
+    }
+    return done;
+}
+
+/* Pop up to n values from one shard; returns the number popped */
+static unsigned int shard_pop(struct int_stack *s, struct int_stack_shard *sh,
+                              int *values, unsigned int n, unsigned int flags)
+{
+    unsigned int done = 0, chunk, moved;
+    unsigned long irqflags;
+
+    while (done < n) {
+        chunk = n - done;
+        if (!(flags & INT_STACK_NOWAIT))
+            chunk = min(chunk, (unsigned int)BATCH_CHUNK);
+        spin_lock_irqsave(&sh->lock, irqflags);
+        moved = shard_pop_many(s, sh, values + done, chunk);
+        spin_unlock_irqrestore(&sh->lock, irqflags);
+        done += moved;
+        if (moved < chunk)
+            break;
+        if (!(flags & INT_STACK_NOWAIT))
+            cond_resched();
+    }
+    return done;
+}
+
+/* Pop up to n values, local shard first, then the other nodes in order */
+static unsigned int stack_pop(struct int_stack *s, int *values,
+                              unsigned int n, unsigned int flags)
+{
+    unsigned int i, first = stack_local_shard(s), done = 0;
+
+    for (i = 0; i < s->nr_shards && done < n; i++)
+        done += shard_pop(s, s->shard[(first + i) % s->nr_shards],
+                          values + done, n - done, flags);
+    return done;
+}
+
+/* Read the value stack_pop() would return next, leaving it on the stack */
+static bool stack_peek(struct int_stack *s, int *value)
+{
+    struct int_stack_shard *sh;
+    unsigned int i, first = stack_local_shard(s);
+    unsigned long flags;
+    bool found = false;
+
+    for (i = 0; i < s->nr_shards && !found; i++) {
+        sh = s->shard[(first + i) % s->nr_shards];
+        spin_lock_irqsave(&sh->lock, flags);
+        found = sh->size != 0;
+        if (found)
+            *value = shard_chunk(sh, shard_data(sh),
+                                 (sh->size - 1) / CHUNK_INTS)
+                         ->v[(sh->size - 1) % CHUNK_INTS];
+        spin_unlock_irqrestore(&sh->lock, flags);
+    }
+    return found;
+}
+
+/* Empty the int stack, keeping its chunks for reuse */
+static void int_stack_cleanup_ints(struct int_stack *s)
+{
+    struct int_stack_shard *sh;
+    unsigned long flags;
+    unsigned int i;
+    for (i = 0; i < s->nr_shards; i++) {
+        sh = s->shard[i];
+        spin_lock_irqsave(&sh->lock, flags);
+        write_seqcount_begin(&sh->seq);
+        sh->size = 0;
+        write_seqcount_end(&sh->seq);
+        shard_settle(s, sh);
+        spin_unlock_irqrestore(&sh->lock, flags);
+    }
+}
+
+/*
+ * Free up to nr unused chunks from the tail; returns the number freed.
+ * Snapshot readers never look past size, so this needs no seqcount bump;
+ * a reader that raced with a pop still sees the chunk until RCU expires.
+ */
+static unsigned long shard_trim(struct int_stack_shard *sh, unsigned long nr)
+{
+    struct int_stack_data *d;
+    struct int_stack_chunk *c;
+    unsigned long flags, freed = 0;
+    unsigned int keep;
+
+    spin_lock_irqsave(&sh->lock, flags);
+    d = shard_data(sh);
+    keep = shard_chunks_used(sh);
+    while (sh->nr_chunks > keep && freed < nr) {
+        sh->nr_chunks--;
+        c = shard_chunk(sh, d, sh->nr_chunks);
+        RCU_INIT_POINTER(d->chunk[sh->nr_chunks], NULL);
+        kfree_rcu(c, rcu);
+        freed++;
+    }
+    spin_unlock_irqrestore(&sh->lock, flags);
+    return freed;
+}
+
+static unsigned long stack_trim(struct int_stack *s, unsigned long nr)
+{
+    unsigned long freed = 0;
+    unsigned int i;
+    for (i = 0; i < s->nr_shards && freed < nr; i++)
+        freed += shard_trim(s->shard[i], nr - freed);
+    return freed;
 }
 
+/*
+ * Swap in a new chunk directory, with target as the shard's share and
+ * limit (at most the directory's size) as its capacity, dropping values
+ * and chunks past them. Returns the old directory, which the caller
+ * frees after an RCU grace period. Caller holds resize_lock and sh->lock.
+ */
+static struct int_stack_data *shard_swap_data(struct int_stack_shard *sh,
+                                              struct int_stack_data *new_data,
+                                              unsigned int target,
+                                              unsigned int limit)
+{
+    struct int_stack_data *old_data = shard_data(sh);
+    struct int_stack_chunk *c;
+    unsigned int i;
+
+    write_seqcount_begin(&sh->seq);
+    if (limit < sh->size) {
+        printk(KERN_WARNING "int_stack: Shrinking %u→%u, data lost\n",
+               sh->size, limit);
+        sh->size = limit;
+    }
+    while (sh->nr_chunks > new_data->nchunks) {
+        sh->nr_chunks--;
+        c = shard_chunk(sh, old_data, sh->nr_chunks);
+        kfree_rcu(c, rcu);
+    }
+    for (i = 0; i < sh->nr_chunks; i++)
+        RCU_INIT_POINTER(new_data->chunk[i], shard_chunk(sh, old_data, i));
+    rcu_assign_pointer(sh->data, new_data);
+    sh->target   = target;
+    sh->max_size = limit;
+    write_seqcount_end(&sh->seq);
+    return old_data;
+}
+
+/*
+ * Capacity of each shard once the stack holds new_size: its share, plus
+ * what a shard still holding more than that borrows from the shards with
+ * room to spare, so the capacities add up to exactly new_size. Values are
+ * dropped only when the whole stack holds more than new_size. All shard
+ * locks held.
+ */
+static void stack_plan_shares(struct int_stack *s, unsigned int new_size,
+                              unsigned int *limit)
+{
+    unsigned int i, share, size, room = 0, over = 0, lend;
+
+    for (i = 0; i < s->nr_shards; i++) {
+        share = shard_cap(s, new_size, i);
+        size  = s->shard[i]->size;
+        if (size > share)
+            over += size - share;
+        else
+            room += share - size;
+    }
+    over = lend = min(over, room);
+    for (i = 0; i < s->nr_shards; i++) {
+        share = shard_cap(s, new_size, i);
+        size  = s->shard[i]->size;
+        if (size > share) {
+            limit[i] = share + min(size - share, over);
+            over    -= limit[i] - share;
+        } else {
+            limit[i] = share - min(share - size, lend);
+            lend    -= share - limit[i];
+        }
+    }
+}
+
+/* Caller holds resize_lock */
 static int stack_resize(struct int_stack *s, unsigned int new_size)
 {
-    int *new_data;
-    if (!s || !s->data || new_size == 0)
+    struct int_stack_data **dirs;
+    unsigned int *limit, i;
+    unsigned long flags;
+    int ret = SUCCESS;
+    if (!s || new_size == 0)
         return -EINVAL;
-    if (new_size < s->size) {
-        printk(KERN_WARNING "int_stack: Shrinking %u→%u, data lost\n",
-               s->size, new_size);
-        s->size = new_size;
+    /* Only the directories are allocated here; chunks follow on demand */
+    dirs  = kcalloc(s->nr_shards, sizeof(*dirs), GFP_KERNEL);
+    limit = kcalloc(s->nr_shards, sizeof(*limit), GFP_KERNEL);
+    if (!dirs || !limit) {
+        ret = -ENOMEM;
+        goto out;
     }
-    new_data = kmalloc(sizeof(int) * new_size, GFP_KERNEL);
-    if (!new_data)
-        return -ENOMEM;
-    if (s->size)
-        memcpy(new_data, s->data, sizeof(int) * s->size);
-    kfree(s->data);
-    s->data     = new_data;
-    s->max_size = new_size;
+    for (i = 0; i < s->nr_shards; i++) {
+        dirs[i] = stack_alloc_data(new_size, s->shard[i]->node);
+        if (!dirs[i]) {
+            ret = -ENOMEM;
+            goto out;
+        }
+    }
+
+    /*
+     * The new shares depend on what every shard holds, so all of them
+     * are swapped under all the shard locks; capacity lent out before
+     * is folded back into the new plan.
+     */
+    local_irq_save(flags);
+    for (i = 0; i < s->nr_shards; i++)
+        spin_lock_nest_lock(&s->shard[i]->lock, &s->resize_lock);
+    stack_plan_shares(s, new_size, limit);
+    for (i = 0; i < s->nr_shards; i++)
+        dirs[i] = shard_swap_data(s->shard[i], dirs[i],
+                                  shard_cap(s, new_size, i), limit[i]);
+    atomic_set(&s->spare, 0);
+    WRITE_ONCE(s->max_size, new_size);
+    for (i = s->nr_shards; i-- > 0; )
+        spin_unlock(&s->shard[i]->lock);
+    local_irq_restore(flags);
+
+    /* Snapshot readers may still be walking the old directories */
+    synchronize_rcu();
     printk(KERN_INFO "int_stack: Resized to %u\n", new_size);
+out:
+    for (i = 0; dirs && i < s->nr_shards; i++)
+        kvfree(dirs[i]);
+    kfree(dirs);
+    kfree(limit);
+    return ret;
+}
+
+/*
+ * Move an unsharded stack's memory to node: a new directory there, then
+ * each chunk copied over on its own, so pushers and poppers only ever
+ * wait for one page copy. Caller holds resize_lock.
+ */
+static int stack_set_node(struct int_stack *s, int node)
+{
+    struct int_stack_shard *sh = s->shard[0];
+    struct int_stack_chunk *c, *old;
+    struct int_stack_data *d;
+    unsigned long flags;
+    unsigned int idx;
+    bool local;
+
+    if (s->nr_shards > 1)
+        return -EINVAL;   /* each shard stays on its own node */
+    d = stack_alloc_data(shard_data(sh)->cap, node);
+    if (!d)
+        return -ENOMEM;
+    WRITE_ONCE(sh->node, node);
+    spin_lock_irqsave(&sh->lock, flags);
+    d = shard_swap_data(sh, d, sh->target, sh->max_size);
+    spin_unlock_irqrestore(&sh->lock, flags);
+    synchronize_rcu();
+    kvfree(d);
+    if (node == NUMA_NO_NODE)
+        return SUCCESS;
+
+    for (idx = 0; idx < READ_ONCE(sh->nr_chunks); idx++) {
+        rcu_read_lock();
+        c = rcu_dereference(shard_data(sh)->chunk[idx]);
+        local = !c || c->nid == node;
+        rcu_read_unlock();
+        if (local)
+            continue;
+        c = kmalloc_node(CHUNK_BYTES, GFP_KERNEL_ACCOUNT, node);
+        if (!c)
+            return -ENOMEM;
+        c->nid = chunk_nid(c);
+
+        spin_lock_irqsave(&sh->lock, flags);
+        old = idx < sh->nr_chunks ? shard_chunk(sh, shard_data(sh), idx)
+                                  : NULL;
+        if (old) {
+            /*
+             * Readers still on the old chunk see the same values, and
+             * any later write bumps the seqcount as usual.
+             */
+            memcpy(c->v, old->v, sizeof(int) * CHUNK_INTS);
+            rcu_assign_pointer(shard_data(sh)->chunk[idx], c);
+            c = NULL;
+        }
+        spin_unlock_irqrestore(&sh->lock, flags);
+        if (old)
+            kfree_rcu(old, rcu);
+        kfree(c);
+        cond_resched();
+    }
+    printk(KERN_INFO "int_stack: Moved to node %d\n", node);
     return SUCCESS;
 }
 
-/* —— Character device methods —— */
+/*
+ * Copy the first n values out of directory d. Returns false if a chunk is
+ * missing, which a lockless reader can see when it raced with a writer.
+ */
+static bool stack_copy(struct int_stack_data *d, int *buf, unsigned int n)
+{
+    struct int_stack_chunk *c;
+    unsigned int idx, k;
 
-static int device_open(struct inode *inode, struct file *file)
+    for (idx = 0; n; idx++) {
+        c = rcu_dereference_check(d->chunk[idx], 1);
+        if (!c)
+            return false;
+        k = min(n, CHUNK_INTS);
+        memcpy(buf, c->v, sizeof(int) * k);
+        buf += k;
+        n   -= k;
+    }
+    return true;
+}
+
+/*
+ * Copy one shard's data[0..size) into a new buffer as of one point in
+ * time. Pushers and poppers are not blocked: the copy is taken under RCU
+ * and retried if a writer changed the shard meanwhile. Only a shard that
+ * keeps changing faster than it can be copied falls back to the lock.
+ */
+static int shard_snapshot_values(struct int_stack_shard *sh, int **bufp,
+                                 unsigned int *countp)
 {
-    if (!stack) {
-        stack = kmalloc(sizeof(*stack), GFP_KERNEL);
-        if (!stack)
+    struct int_stack_data *d;
+    unsigned int seq, n, cap = 0, tries = 0;
+    unsigned long flags;
+    bool ok;
+    int *buf = NULL;
+
+    for (;;) {
+        n = READ_ONCE(sh->size);
+        if (n > cap) {
+            kvfree(buf);
+            cap = n;
+            buf = kvmalloc_array(cap, sizeof(int), GFP_KERNEL_ACCOUNT);
+            if (!buf)
+                return -ENOMEM;
+        }
+
+        if (++tries > SNAPSHOT_RETRIES) {
+            spin_lock_irqsave(&sh->lock, flags);
+            n = sh->size;
+            if (n <= cap)
+                stack_copy(shard_data(sh), buf, n);
+            spin_unlock_irqrestore(&sh->lock, flags);
+            if (n <= cap)
+                break;
+            continue;   /* grew before we got the lock, reallocate */
+        }
+
+        /*
+         * size and data may come from different sides of a resize;
+         * the retry check throws such a copy away, and clamping to the
+         * directory actually read keeps it in bounds until then.
+         */
+        rcu_read_lock();
+        seq = read_seqcount_begin(&sh->seq);
+        d = rcu_dereference(sh->data);
+        n = min(sh->size, d->cap);
+        ok = n <= cap && stack_copy(d, buf, n);
+        rcu_read_unlock();
+        if (ok && !read_seqcount_retry(&sh->seq, seq))
+            break;
+    }
+
+    *bufp   = buf;
+    *countp = n;
+    return SUCCESS;
+}
+
+/*
+ * Copy the whole int stack, bottom first. Sharded, the shards follow each
+ * other in node order, each consistent on its own.
+ */
+static int stack_snapshot_values(struct int_stack *s, int **bufp,
+                                 unsigned int *countp)
+{
+    unsigned int i, n, total = 0;
+    int *buf = NULL, *part, *all;
+    int ret;
+
+    for (i = 0; i < s->nr_shards; i++) {
+        ret = shard_snapshot_values(s->shard[i], &part, &n);
+        if (ret < 0) {
+            kvfree(buf);
+            return ret;
+        }
+        if (!buf) {
+            buf   = part;
+            total = n;
+            continue;
+        }
+        if (n) {
+            all = kvmalloc_array(total + n, sizeof(int), GFP_KERNEL_ACCOUNT);
+            if (!all) {
+                kvfree(part);
+                kvfree(buf);
+                return -ENOMEM;
+            }
+            memcpy(all, buf, sizeof(int) * total);
+            memcpy(all + total, part, sizeof(int) * n);
+            kvfree(buf);
+            buf    = all;
+            total += n;
+        }
+        kvfree(part);
+    }
+
+    *bufp   = buf;
+    *countp = total;
+    return SUCCESS;
+}
+
+/* Replace the snapshot a file in INT_STACK_READ_SNAPSHOT mode reads from */
+static int stack_snapshot(struct int_stack *s, struct int_stack_file *f)
+{
+    unsigned int n;
+    int *buf;
+    int ret = stack_snapshot_values(s, &buf, &n);
+    if (ret < 0)
+        return ret;
+    kvfree(f->snap);
+    f->snap       = buf;
+    f->snap_bytes = sizeof(int) * n;
+    return SUCCESS;
+}
+
+/* —— Blob stack —— */
+
+/* Push one blob of length bytes from userspace */
+static ssize_t blob_push(struct int_stack *s, const char __user *buffer,
+                         size_t length)
+{
+    struct int_stack_blob *b;
+    if (length == 0)
+        return -EINVAL;   /* a 0-byte read means "empty" */
+    if (length > blob_max_size)
+        return -EMSGSIZE;
+    /* Copy in before taking the lock; the cache charges the caller's memcg */
+    b = kmem_cache_alloc(blob_cache, GFP_KERNEL);
+    if (!b)
+        return -ENOMEM;
+    if (copy_from_user(b->data, buffer, length)) {
+        kmem_cache_free(blob_cache, b);
+        return -EFAULT;
+    }
+    b->len = length;
+
+    spin_lock(&s->blob_lock);
+    if (s->nr_blobs >= READ_ONCE(blob_max_count) ||
+        s->blob_bytes + length > READ_ONCE(blob_max_bytes)) {
+        spin_unlock(&s->blob_lock);
+        kmem_cache_free(blob_cache, b);
+        return -ERANGE;
+    }
+    b->next  = s->blobs;
+    s->blobs = b;
+    s->nr_blobs++;
+    s->blob_bytes += length;
+    spin_unlock(&s->blob_lock);
+    return length;
+}
+
+/*
+ * Pop the top blob into a buffer of length bytes. A buffer too small for
+ * it fails with -EMSGSIZE and leaves the blob on the stack.
+ */
+static ssize_t blob_pop(struct int_stack *s, char __user *buffer,
+                        size_t length)
+{
+    struct int_stack_blob *b;
+    ssize_t ret;
+
+    spin_lock(&s->blob_lock);
+    b = s->blobs;
+    if (!b) {
+        spin_unlock(&s->blob_lock);
+        return 0; /* empty → EOF */
+    }
+    if (b->len > length) {
+        spin_unlock(&s->blob_lock);
+        return -EMSGSIZE;
+    }
+    s->blobs = b->next;
+    s->nr_blobs--;
+    s->blob_bytes -= b->len;
+    spin_unlock(&s->blob_lock);
+
+    ret = copy_to_user(buffer, b->data, b->len) ? -EFAULT : b->len;
+    kmem_cache_free(blob_cache, b);
+    return ret;
+}
+
+static void blob_clear(struct int_stack *s)
+{
+    struct int_stack_blob *b, *next;
+
+    spin_lock(&s->blob_lock);
+    b = s->blobs;
+    s->blobs      = NULL;
+    s->nr_blobs   = 0;
+    s->blob_bytes = 0;
+    spin_unlock(&s->blob_lock);
+
+    for (; b; b = next) {
+        next = b->next;
+        kmem_cache_free(blob_cache, b);
+    }
+}
+
+/* —— Checkpoint/restore —— */
+
+static u32 ckpt_crc(const void *data, size_t len)
+{
+    return crc32_le(~0, data, len) ^ ~0;   /* same CRC-32 as zlib */
+}
+
+/*
+ * Refill the emptied int stack from a checkpoint. Values go to the shards
+ * in node order, each up to its capacity, which puts them back where a
+ * checkpoint of an identically sharded stack found them.
+ */
+static int stack_fill(struct int_stack *s, const int *vals, unsigned int n)
+{
+    unsigned int i, k, done = 0;
+    bool full;
+
+    for (i = 0; i < s->nr_shards && done < n; i++) {
+        k = min(n - done, s->shard[i]->target);
+        if (shard_push(s, s->shard[i], vals + done, k, 0, &full) < k)
             return -ENOMEM;
-        if (stack_init(stack, DEFAULT_STACK_SIZE) != SUCCESS) {
-            kfree(stack);
-            stack = NULL;
+        done += k;
+    }
+    return done < n ? -ENOMEM : 0;
+}
+
+/*
+ * Serialize both stacks into one buffer (see struct int_stack_ckpt_header).
+ * The int stack is copied with stack_snapshot_values(); the blob stack is
+ * copied under blob_lock, retrying if it changed size while the buffer
+ * was being allocated.
+ */
+static void *stack_checkpoint(struct int_stack *s, size_t *lenp)
+{
+    struct int_stack_ckpt_header *h;
+    struct int_stack_blob *b;
+    unsigned int n, i, nb;
+    unsigned long bytes;
+    __le32 *ints;
+    size_t len;
+    u8 *img, *pos;
+    int *vals, ret;
+
+    ret = stack_snapshot_values(s, &vals, &n);
+    if (ret < 0)
+        return ERR_PTR(ret);
+
+    for (;;) {
+        nb    = READ_ONCE(s->nr_blobs);
+        bytes = READ_ONCE(s->blob_bytes);
+        len = sizeof(*h) + sizeof(__le32) * ((size_t)n + nb) + bytes;
+        img = kvmalloc(len, GFP_KERNEL_ACCOUNT);
+        if (!img) {
+            kvfree(vals);
+            return ERR_PTR(-ENOMEM);
+        }
+        spin_lock(&s->blob_lock);
+        if (s->nr_blobs == nb && s->blob_bytes == bytes)
+            break;
+        spin_unlock(&s->blob_lock);
+        kvfree(img);
+    }
+    /* The list is top first; fill from the end so the image is bottom first */
+    pos = img + len;
+    for (b = s->blobs; b; b = b->next) {
+        pos -= b->len;
+        memcpy(pos, b->data, b->len);
+        pos -= sizeof(__le32);
+        put_unaligned_le32(b->len, pos);
+    }
+    spin_unlock(&s->blob_lock);
+
+    h = (struct int_stack_ckpt_header *)img;
+    ints = (__le32 *)(h + 1);
+    for (i = 0; i < n; i++)
+        ints[i] = cpu_to_le32(vals[i]);
+    kvfree(vals);
+
+    h->magic       = cpu_to_le32(INT_STACK_CKPT_MAGIC);
+    h->version     = cpu_to_le16(INT_STACK_CKPT_VERSION);
+    h->header_size = cpu_to_le16(sizeof(*h));
+    h->max_size    = cpu_to_le32(READ_ONCE(s->max_size));
+    h->count       = cpu_to_le32(n);
+    h->blob_count  = cpu_to_le32(nb);
+    h->crc         = cpu_to_le32(ckpt_crc(h + 1, len - sizeof(*h)));
+    *lenp = len;
+    return img;
+}
+
+/*
+ * Replace both stacks with a checkpoint image. Everything is validated,
+ * and all blobs allocated, before the stacks are touched, so a bad image
+ * leaves them as they were. Meant for a freshly loaded, idle stack:
+ * concurrent pushers may interleave with the restored values.
+ */
+static int stack_restore(struct int_stack *s, void *img, size_t len)
+{
+    const struct int_stack_ckpt_header *h = img;
+    struct int_stack_blob **blobs = NULL;
+    unsigned int hsize, max_size, n, nb, i, blen;
+    unsigned long bytes = 0;
+    __le32 *ints;
+    int *vals;
+    u8 *pos, *end = (u8 *)img + len;
+    int ret;
+
+    if (len < sizeof(*h) || le32_to_cpu(h->magic) != INT_STACK_CKPT_MAGIC)
+        return -EINVAL;
+    if (le16_to_cpu(h->version) != INT_STACK_CKPT_VERSION)
+        return -EPROTONOSUPPORT;
+    hsize    = le16_to_cpu(h->header_size);
+    max_size = le32_to_cpu(h->max_size);
+    n        = le32_to_cpu(h->count);
+    nb       = le32_to_cpu(h->blob_count);
+    if (hsize < sizeof(*h) || hsize % sizeof(__le32) || hsize > len)
+        return -EINVAL;
+    if (ckpt_crc((u8 *)img + sizeof(*h), len - sizeof(*h)) !=
+        le32_to_cpu(h->crc))
+        return -EBADMSG;
+    if (max_size == 0 || n > max_size ||
+        (len - hsize) / sizeof(__le32) < n)
+        return -EINVAL;
+
+    /* Walk the blob records once to check them against this module's limits */
+    pos = (u8 *)img + hsize + sizeof(__le32) * (size_t)n;
+    for (i = 0; i < nb; i++) {
+        if (end - pos < sizeof(__le32))
+            return -EINVAL;
+        blen = get_unaligned_le32(pos);
+        pos += sizeof(__le32);
+        if (blen == 0 || blen > end - pos)
+            return -EINVAL;
+        if (blen > blob_max_size)
+            return -EMSGSIZE;
+        bytes += blen;
+        pos   += blen;
+    }
+    if (pos != end)
+        return -EINVAL;
+    if (nb > READ_ONCE(blob_max_count) || bytes > READ_ONCE(blob_max_bytes))
+        return -ERANGE;
+
+    if (nb) {
+        blobs = kvmalloc_array(nb, sizeof(*blobs), GFP_KERNEL);
+        if (!blobs)
             return -ENOMEM;
+    }
+    pos = (u8 *)img + hsize + sizeof(__le32) * (size_t)n;
+    for (i = 0; i < nb; i++) {
+        blobs[i] = kmem_cache_alloc(blob_cache, GFP_KERNEL);
+        if (!blobs[i]) {
+            while (i--)
+                kmem_cache_free(blob_cache, blobs[i]);
+            kvfree(blobs);
+            return -ENOMEM;
+        }
+        blobs[i]->len = get_unaligned_le32(pos);
+        memcpy(blobs[i]->data, pos + sizeof(__le32), blobs[i]->len);
+        pos += sizeof(__le32) + blobs[i]->len;
+    }
+
+    /* The image is our own copy, so the ints can be converted in place */
+    ints = (__le32 *)((u8 *)img + hsize);
+    vals = (int *)ints;
+    for (i = 0; i < n; i++)
+        vals[i] = le32_to_cpu(ints[i]);
+
+    mutex_lock(&s->resize_lock);
+    ret = max_size == s->max_size ? 0 : stack_resize(s, max_size);
+    if (ret == 0) {
+        int_stack_cleanup_ints(s);
+        ret = stack_fill(s, vals, n);
+    }
+    mutex_unlock(&s->resize_lock);
+
+    if (ret == 0) {
+        blob_clear(s);
+        spin_lock(&s->blob_lock);
+        for (i = 0; i < nb; i++) {
+            blobs[i]->next = s->blobs;
+            s->blobs = blobs[i];
+        }
+        s->nr_blobs   = nb;
+        s->blob_bytes = bytes;
+        spin_unlock(&s->blob_lock);
+    } else {
+        for (i = 0; i < nb; i++)
+            kmem_cache_free(blob_cache, blobs[i]);
+    }
+    kvfree(blobs);
+    if (ret == 0)
+        printk(KERN_INFO "int_stack: Restored %u ints and %u blobs\n", n, nb);
+    return ret;
+}
+
+static long ioctl_checkpoint(struct int_stack_xfer __user *uxfer)
+{
+    struct int_stack_xfer xfer;
+    size_t len;
+    void *img;
+    long ret = 0;
+
+    if (copy_from_user(&xfer, uxfer, sizeof(xfer)))
+        return -EFAULT;
+    img = stack_checkpoint(stack, &len);
+    if (IS_ERR(img))
+        return PTR_ERR(img);
+    if (xfer.len < len)
+        ret = -ENOSPC;
+    else if (copy_to_user(u64_to_user_ptr(xfer.addr), img, len))
+        ret = -EFAULT;
+    kvfree(img);
+    /* Report the size either way, so a caller can size its buffer */
+    if (ret != -EFAULT && put_user((u64)len, &uxfer->len))
+        ret = -EFAULT;
+    return ret;
+}
+
+static long ioctl_restore(struct int_stack_xfer __user *uxfer)
+{
+    struct int_stack_xfer xfer;
+    void *img;
+    long ret;
+
+    if (copy_from_user(&xfer, uxfer, sizeof(xfer)))
+        return -EFAULT;
+    if (xfer.len > INT_MAX)
+        return -E2BIG;
+    img = vmemdup_user(u64_to_user_ptr(xfer.addr), xfer.len);
+    if (IS_ERR(img))
+        return PTR_ERR(img);
+    ret = stack_restore(stack, img, xfer.len);
+    kvfree(img);
+    return ret;
+}
+
+/* —— Memory reclaim —— */
+
+static void stack_schedule_trim(struct int_stack *s)
+{
+    struct int_stack_shard *sh;
+    unsigned int delay = READ_ONCE(trim_delay_ms), i;
+    if (!delay)
+        return;
+    for (i = 0; i < s->nr_shards; i++) {
+        sh = s->shard[i];
+        if (READ_ONCE(sh->nr_chunks) > shard_chunks_used(sh)) {
+            schedule_delayed_work(&s->trim_work, msecs_to_jiffies(delay));
+            return;
+        }
+    }
+}
+
+static void stack_trim_work(struct work_struct *work)
+{
+    struct int_stack *s = container_of(to_delayed_work(work),
+                                       struct int_stack, trim_work);
+    unsigned int delay = READ_ONCE(trim_delay_ms), i;
+    unsigned long now = jiffies, idle_at, next = 0;
+    bool busy = false;
+
+    if (!delay)
+        return;
+    for (i = 0; i < s->nr_shards; i++) {
+        idle_at = READ_ONCE(s->shard[i]->last_used) + msecs_to_jiffies(delay);
+        if (time_before(now, idle_at)) {
+            if (!busy || time_before(idle_at, next))
+                next = idle_at;
+            busy = true;
+        } else {
+            shard_trim(s->shard[i], ULONG_MAX);
+        }
+    }
+    /*
+     * Still in use: check again once the next shard could have gone idle.
+     * next is after the one jiffies sample taken above, so this cannot wrap.
+     */
+    if (busy)
+        schedule_delayed_work(&s->trim_work, next - now);
+}
+
+static unsigned long stack_shrink_count(struct shrinker *shrinker,
+                                        struct shrink_control *sc)
+{
+    struct int_stack_shard *sh;
+    unsigned long count = 0;
+    unsigned int used, alloc, i;
+    for (i = 0; i < stack->nr_shards; i++) {
+        sh = stack->shard[i];
+        used  = shard_chunks_used(sh);
+        alloc = READ_ONCE(sh->nr_chunks);
+        if (alloc > used)
+            count += alloc - used;
+    }
+    return count ? count : SHRINK_EMPTY;
+}
+
+static unsigned long stack_shrink_scan(struct shrinker *shrinker,
+                                       struct shrink_control *sc)
+{
+    unsigned long freed = stack_trim(stack, sc->nr_to_scan);
+    return freed ? freed : SHRINK_STOP;
+}
+
+/* The shrinker API changed in 6.0 (name) and 6.7 (dynamic allocation) */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+static struct shrinker *stack_shrinker;
+
+static int stack_register_shrinker(void)
+{
+    stack_shrinker = shrinker_alloc(0, DEVICE_NAME);
+    if (!stack_shrinker)
+        return -ENOMEM;
+    stack_shrinker->count_objects = stack_shrink_count;
+    stack_shrinker->scan_objects  = stack_shrink_scan;
+    stack_shrinker->seeks         = DEFAULT_SEEKS;
+    shrinker_register(stack_shrinker);
+    return 0;
+}
+
+static void stack_unregister_shrinker(void)
+{
+    shrinker_free(stack_shrinker);
+}
+#else
+static struct shrinker stack_shrinker = {
+    .count_objects = stack_shrink_count,
+    .scan_objects  = stack_shrink_scan,
+    .seeks         = DEFAULT_SEEKS,
+};
+
+static int stack_register_shrinker(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+    return register_shrinker(&stack_shrinker, DEVICE_NAME);
+#else
+    return register_shrinker(&stack_shrinker);
+#endif
+}
+
+static void stack_unregister_shrinker(void)
+{
+    unregister_shrinker(&stack_shrinker);
+}
+#endif
+
+/* —— io_uring passthrough —— */
+
+#if HAVE_URING_CMD
+/* State of a waiting pop, kept in io_uring_cmd->pdu */
+struct uring_pop_pdu {
+    struct list_head   node;      /* on uring_waiters, or a ready list */
+    u64                addr;      /* where the value goes */
+    int                value;     /* popped for us by a pusher */
+    bool               queued;    /* still on uring_waiters */
+};
+
+static inline struct uring_pop_pdu *uring_pdu(struct io_uring_cmd *cmd)
+{
+    BUILD_BUG_ON(sizeof(struct uring_pop_pdu) > sizeof(cmd->pdu));
+    return (struct uring_pop_pdu *)cmd->pdu;
+}
+
+static inline void uring_done(struct io_uring_cmd *cmd, int ret,
+                              unsigned int issue_flags)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    io_uring_cmd_done(cmd, ret, 0, issue_flags);
+#else
+    io_uring_cmd_done(cmd, ret, 0);
+#endif
+}
+
+static int uring_put_value(u64 addr, int value)
+{
+    return put_user(value, (int __user *)u64_to_user_ptr(addr)) ? -EFAULT : 1;
+}
+
+/* Runs in the submitter's task, where the user address is reachable */
+static void uring_pop_finish(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+    struct uring_pop_pdu *pdu = uring_pdu(cmd);
+    uring_done(cmd, uring_put_value(pdu->addr, pdu->value), issue_flags);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+#define uring_pop_task uring_pop_finish
+#else
+static void uring_pop_task(struct io_uring_cmd *cmd)
+{
+    uring_pop_finish(cmd, 0);
+}
+#endif
+#endif /* HAVE_URING_CMD */
+
+/*
+ * Hand freshly pushed values to waiting io_uring pops, oldest waiter
+ * first. Called by pushers after they drop the shard lock; the waiters
+ * are completed once waiters_lock is dropped too.
+ */
+static void uring_feed_waiters(struct int_stack *s)
+{
+#if HAVE_URING_WAIT
+    struct uring_pop_pdu *pdu, *next;
+    unsigned long flags;
+    LIST_HEAD(ready);
+
+    /*
+     * Pairs with the barrier in uring_pop_wait(): either it sees the
+     * values just pushed, or we see it on the list.
+     */
+    smp_mb();
+    if (!READ_ONCE(s->nr_waiters))
+        return;
+    spin_lock_irqsave(&s->waiters_lock, flags);
+    while (!list_empty(&s->uring_waiters)) {
+        pdu = list_first_entry(&s->uring_waiters, struct uring_pop_pdu, node);
+        if (!stack_pop(s, &pdu->value, 1, INT_STACK_NOWAIT))
+            break;
+        pdu->queued = false;
+        list_move_tail(&pdu->node, &ready);
+        WRITE_ONCE(s->nr_waiters, s->nr_waiters - 1);
+    }
+    spin_unlock_irqrestore(&s->waiters_lock, flags);
+
+    list_for_each_entry_safe(pdu, next, &ready, node) {
+        list_del_init(&pdu->node);
+        io_uring_cmd_complete_in_task(container_of((void *)pdu,
+                                                   struct io_uring_cmd, pdu),
+                                      uring_pop_task);
+    }
+#endif
+}
+
+#if HAVE_URING_WAIT
+/*
+ * Pop a value, or park the command on uring_waiters until a pusher hands
+ * it one. The command is queued before the stack is looked at, so a push
+ * racing with us either is seen here or finds us in uring_feed_waiters().
+ */
+static int uring_pop_wait(struct int_stack *s, struct io_uring_cmd *cmd,
+                          u64 addr, unsigned int issue_flags)
+{
+    struct uring_pop_pdu *pdu = uring_pdu(cmd);
+    unsigned long flags;
+    int value;
+    bool popped;
+
+    io_uring_cmd_mark_cancelable(cmd, issue_flags);
+    pdu->addr = addr;
+    spin_lock_irqsave(&s->waiters_lock, flags);
+    pdu->queued = true;
+    list_add_tail(&pdu->node, &s->uring_waiters);
+    WRITE_ONCE(s->nr_waiters, s->nr_waiters + 1);
+    smp_mb();
+    popped = stack_pop(s, &value, 1, INT_STACK_NOWAIT);
+    if (popped) {
+        list_del_init(&pdu->node);
+        pdu->queued = false;
+        WRITE_ONCE(s->nr_waiters, s->nr_waiters - 1);
+    }
+    spin_unlock_irqrestore(&s->waiters_lock, flags);
+    if (!popped)
+        return -EIOCBQUEUED;
+    stack_schedule_trim(s);
+    return uring_put_value(addr, value);
+}
+
+/* The ring is going away: take back a pop that is still waiting */
+static int uring_pop_cancel(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+    struct uring_pop_pdu *pdu = uring_pdu(cmd);
+    unsigned long flags;
+    bool queued;
+
+    spin_lock_irqsave(&stack->waiters_lock, flags);
+    queued = pdu->queued;
+    if (queued) {
+        list_del_init(&pdu->node);
+        pdu->queued = false;
+        WRITE_ONCE(stack->nr_waiters, stack->nr_waiters - 1);
+    }
+    spin_unlock_irqrestore(&stack->waiters_lock, flags);
+    if (queued)
+        uring_done(cmd, -ECANCELED, issue_flags);
+    return 0;
+}
+#endif
+
+#if HAVE_URING_CMD
+/*
+ * IORING_OP_URING_CMD entry point. Every command completes inline except
+ * a waiting pop on an empty stack, which is parked on uring_waiters and
+ * completed from the next push without holding a thread.
+ */
+static int device_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+    const struct int_stack_uring_cmd *p = io_uring_sqe_cmd(cmd->sqe);
+#else
+    const struct int_stack_uring_cmd *p = cmd->cmd;
+#endif
+    /* The SQE is shared with userspace; read each field once */
+    u64 addr = READ_ONCE(p->addr);
+    int value = READ_ONCE(p->value);
+    u32 cflags = READ_ONCE(p->flags);
+    int ret;
+
+#if HAVE_URING_WAIT
+    if (issue_flags & IO_URING_F_CANCEL)
+        return uring_pop_cancel(cmd, issue_flags);
+#endif
+    if (cflags & ~INT_STACK_URING_WAIT)
+        return -EINVAL;
+
+    switch (cmd->cmd_op) {
+    case INT_STACK_URING_PUSH:
+        /* Without a blocking context, let io-wq retry a failed allocation */
+        if (issue_flags & IO_URING_F_NONBLOCK) {
+            ret = int_stack_push_batch(&value, 1, INT_STACK_NOWAIT);
+            if (ret == -ENOMEM)
+                return -EAGAIN;
+        } else {
+            ret = int_stack_push_batch(&value, 1, 0);
         }
+        return ret < 0 ? ret : 0;
+
+    case INT_STACK_URING_POP:
+        if (cflags & INT_STACK_URING_WAIT)
+#if HAVE_URING_WAIT
+            return uring_pop_wait(stack, cmd, addr, issue_flags);
+#else
+            return -EOPNOTSUPP;
+#endif
+        ret = int_stack_pop_batch(&value, 1, INT_STACK_NOWAIT);
+        return ret > 0 ? uring_put_value(addr, value) : ret;
+
+    case INT_STACK_URING_PEEK:
+        return stack_peek(stack, &value) ? uring_put_value(addr, value) : 0;
+
+    case INT_STACK_URING_SIZE:
+        return stack_size(stack);
     }
+    return -EINVAL;
+}
+#endif /* HAVE_URING_CMD */
+
+/* —— Character device methods —— */
+
+static int device_open(struct inode *inode, struct file *file)
+{
+    struct int_stack_file *f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return -ENOMEM;
+    f->read_mode = INT_STACK_READ_POP;
+    f->elem_mode = INT_STACK_ELEM_INT;
+    mutex_init(&f->lock);
+    file->private_data = f;
     try_module_get(THIS_MODULE);
     printk(KERN_INFO "int_stack: Device opened\n");
     return SUCCESS;
@@ -154,22 +1621,47 @@ static int device_open(struct inode *inode, struct file *file)
 
 static int device_release(struct inode *inode, struct file *file)
 {
+    struct int_stack_file *f = file->private_data;
+    kvfree(f->snap);
+    kfree(f);
     module_put(THIS_MODULE);
     printk(KERN_INFO "int_stack: Device released\n");
     return SUCCESS;
 }
 
+/* Snapshot mode: a read from offset 0 takes a new snapshot */
+static ssize_t snapshot_read(struct int_stack_file *f, char __user *buffer,
+                             size_t length, loff_t *offset)
+{
+    ssize_t ret;
+    mutex_lock(&f->lock);
+    if (*offset == 0 || !f->snap) {
+        ret = stack_snapshot(stack, f);
+        if (ret < 0)
+            goto out;
+    }
+    ret = simple_read_from_buffer(buffer, length, offset,
+                                  f->snap, f->snap_bytes);
+out:
+    mutex_unlock(&f->lock);
+    return ret;
+}
+
 static ssize_t device_read(struct file *filp, char __user *buffer,
                            size_t length, loff_t *offset)
 {
+    struct int_stack_file *f = filp->private_data;
     int value, ret;
+    if (f->elem_mode == INT_STACK_ELEM_BLOB)
+        return blob_pop(stack, buffer, length);
+    if (f->read_mode == INT_STACK_READ_SNAPSHOT)
+        return snapshot_read(f, buffer, length, offset);
     if (length < sizeof(int))
         return -EINVAL;
-    down_write(&stack->rwsem);
-    ret = stack_pop(stack, &value);
-    up_write(&stack->rwsem);
-    if (ret < 0)
-        return 0; /* empty → EOF */
+    ret = int_stack_pop_batch(&value, 1, 0);
+    if (ret <= 0)
+        return ret; /* empty → EOF */
+    printk(KERN_DEBUG "int_stack: Popped %d\n", value);
     if (copy_to_user(buffer, &value, sizeof(int)))
         return -EFAULT;
     return sizeof(int);
@@ -178,36 +1670,136 @@ static ssize_t device_read(struct file *filp, char __user *buffer,
 static ssize_t device_write(struct file *filp, const char __user *buffer,
                             size_t length, loff_t *offset)
 {
+    struct int_stack_file *f = filp->private_data;
     int value, ret;
+    if (f->elem_mode == INT_STACK_ELEM_BLOB)
+        return blob_push(stack, buffer, length);
     if (length < sizeof(int))
         return -EINVAL;
     if (copy_from_user(&value, buffer, sizeof(int)))
         return -EFAULT;
-    down_write(&stack->rwsem);
-    ret = stack_push(stack, value);
-    up_write(&stack->rwsem);
+    ret = int_stack_push_batch(&value, 1, 0);
+    if (ret == -ERANGE)
+        printk(KERN_WARNING "int_stack: Overflow, cannot push %d\n", value);
     if (ret < 0)
         return ret;
+    printk(KERN_DEBUG "int_stack: Pushed %d\n", value);
     return sizeof(int);
 }
 
+/* Seeking is only meaningful within a snapshot */
+static loff_t device_llseek(struct file *filp, loff_t offset, int whence)
+{
+    struct int_stack_file *f = filp->private_data;
+    loff_t ret;
+    if (f->read_mode != INT_STACK_READ_SNAPSHOT)
+        return -ESPIPE;
+    mutex_lock(&f->lock);
+    ret = f->snap ? 0 : stack_snapshot(stack, f);
+    if (ret == 0)
+        ret = fixed_size_llseek(filp, offset, whence, f->snap_bytes);
+    mutex_unlock(&f->lock);
+    return ret;
+}
+
 static long device_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
-    unsigned int new_size;
-    int ret = 0;
+    struct int_stack_file *f = file->private_data;
+    unsigned int new_size, mode;
+    int node, ret = 0;
     if (cmd == SET_STACK_SIZE) {
         if (get_user(new_size, (unsigned int __user *)arg))
             return -EFAULT;
         if (new_size == 0)
             return -EINVAL;
-        down_write(&stack->rwsem);
+        mutex_lock(&stack->resize_lock);
         ret = stack_resize(stack, new_size);
-        up_write(&stack->rwsem);
+        mutex_unlock(&stack->resize_lock);
         return ret;
     }
+    if (cmd == SET_READ_MODE) {
+        if (get_user(mode, (unsigned int __user *)arg))
+            return -EFAULT;
+        if (mode != INT_STACK_READ_POP && mode != INT_STACK_READ_SNAPSHOT)
+            return -EINVAL;
+        mutex_lock(&f->lock);
+        /* Snapshots cover the int stack only */
+        if (mode == INT_STACK_READ_SNAPSHOT &&
+            f->elem_mode != INT_STACK_ELEM_INT) {
+            mutex_unlock(&f->lock);
+            return -EINVAL;
+        }
+        f->read_mode = mode;
+        kvfree(f->snap);
+        f->snap = NULL;
+        f->snap_bytes = 0;
+        file->f_pos = 0;
+        mutex_unlock(&f->lock);
+        return SUCCESS;
+    }
+    if (cmd == SET_NUMA_NODE) {
+        if (get_user(node, (int __user *)arg))
+            return -EFAULT;
+        if (node != NUMA_NO_NODE &&
+            (node < 0 || node >= nr_node_ids || !node_online(node)))
+            return -EINVAL;
+        mutex_lock(&stack->resize_lock);
+        ret = stack_set_node(stack, node);
+        mutex_unlock(&stack->resize_lock);
+        return ret;
+    }
+    if (cmd == INT_STACK_CHECKPOINT)
+        return ioctl_checkpoint((struct int_stack_xfer __user *)arg);
+    if (cmd == INT_STACK_RESTORE)
+        return ioctl_restore((struct int_stack_xfer __user *)arg);
+    if (cmd == SET_ELEM_MODE) {
+        if (get_user(mode, (unsigned int __user *)arg))
+            return -EFAULT;
+        if (mode != INT_STACK_ELEM_INT && mode != INT_STACK_ELEM_BLOB)
+            return -EINVAL;
+        mutex_lock(&f->lock);
+        if (mode != INT_STACK_ELEM_INT &&
+            f->read_mode != INT_STACK_READ_POP) {
+            mutex_unlock(&f->lock);
+            return -EINVAL;
+        }
+        f->elem_mode = mode;
+        mutex_unlock(&f->lock);
+        return SUCCESS;
+    }
     return -ENOTTY;
 }
 
+/*
+ * /sys/class/int_stack/int_stack/numa_stat: one line per shard with its
+ * node (-1 = none chosen), fill and how many values were pushed or popped
+ * by a CPU on the same node as the memory holding them.
+ */
+static ssize_t numa_stat_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+    struct int_stack_shard *sh;
+    unsigned int i;
+    int len = 0;
+    for (i = 0; i < stack->nr_shards; i++) {
+        sh = stack->shard[i];
+        len += sysfs_emit_at(buf, len,
+                             "shard %u node %d size %u capacity %u local %lu remote %lu\n",
+                             i, READ_ONCE(sh->node), READ_ONCE(sh->size),
+                             READ_ONCE(sh->max_size),
+                             READ_ONCE(sh->local_hits),
+                             READ_ONCE(sh->remote_hits));
+    }
+    return len;
+}
+static DEVICE_ATTR_RO(numa_stat);
+
+static struct attribute *int_stack_attrs[] = {
+    &dev_attr_numa_stat.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(int_stack);
+
 /* Functions exported for the USB key driver */
 int int_stack_create_device(void)
 {
@@ -215,22 +1807,26 @@ int int_stack_create_device(void)
     if (major_number < 0)
         return major_number;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    int_stack_class = class_create(DEVICE_NAME);
+#else
     int_stack_class = class_create(THIS_MODULE, DEVICE_NAME);
+#endif
     if (IS_ERR(int_stack_class)) {
         unregister_chrdev(major_number, DEVICE_NAME);
         return PTR_ERR(int_stack_class);
     }
 
-    int_stack_device = device_create(int_stack_class, NULL,
-                                     MKDEV(major_number, 0),
-                                     NULL, DEVICE_NAME);
+    int_stack_device = device_create_with_groups(int_stack_class, NULL,
+                                                 MKDEV(major_number, 0), NULL,
+                                                 int_stack_groups, DEVICE_NAME);
     if (IS_ERR(int_stack_device)) {
         class_destroy(int_stack_class);
         unregister_chrdev(major_number, DEVICE_NAME);
         return PTR_ERR(int_stack_device);
     }
 
-    printk(KERN_INFO "int_stack: Created device node /dev/%s (major=%d)\n", 
+    printk(KERN_INFO "int_stack: Created device node /dev/%s (major=%d)\n",
            DEVICE_NAME, major_number);
     return 0;
 }
@@ -245,25 +1841,131 @@ void int_stack_remove_device(void)
 }
 EXPORT_SYMBOL(int_stack_remove_device);
 
+/*
+ * Drop the stack contents. The stack itself lives as long as this module,
+ * so in-kernel producers never see it disappear under them.
+ */
 void int_stack_cleanup(void)
 {
-    if (stack) {
-        stack_deinit(stack);
-        kfree(stack);
-        stack = NULL;
-    }
+    int_stack_cleanup_ints(stack);
+    stack_trim(stack, ULONG_MAX);
+    blob_clear(stack);
 }
 EXPORT_SYMBOL(int_stack_cleanup);
 
+/* —— In-kernel producer/consumer API —— */
+
+/*
+ * Push values[0..n) in order, stopping when the stack is full. Returns the
+ * number pushed, or -ERANGE if the stack was already full (-ENOMEM if no
+ * memory could be found for it). Without INT_STACK_NOWAIT the batch is
+ * pushed in chunks with a reschedule point between them, so other pushers
+ * may interleave; with it each shard's part goes in under one lock hold
+ * and the call is safe in atomic context, but growing the stack then
+ * relies on atomic allocations. With numa_shards the values go to the
+ * caller's node first.
+ */
+int int_stack_push_batch(const int *values, unsigned int n, unsigned int flags)
+{
+    unsigned int done;
+    bool full;
+    if ((!values && n) || (flags & ~INT_STACK_NOWAIT))
+        return -EINVAL;
+    if (!(flags & INT_STACK_NOWAIT))
+        might_sleep();
+    done = stack_push(stack, values, n, flags, &full);
+    if (n && !done)
+        return full ? -ERANGE : -ENOMEM;
+    return done;
+}
+EXPORT_SYMBOL(int_stack_push_batch);
+
+/*
+ * Pop up to n values into values[], top of the stack first. Returns the
+ * number popped, 0 if the stack is empty. Flags as for
+ * int_stack_push_batch(); with numa_shards the caller's node is emptied
+ * first.
+ */
+int int_stack_pop_batch(int *values, unsigned int n, unsigned int flags)
+{
+    unsigned int done;
+    if ((!values && n) || (flags & ~INT_STACK_NOWAIT))
+        return -EINVAL;
+    if (!(flags & INT_STACK_NOWAIT))
+        might_sleep();
+    done = stack_pop(stack, values, n, flags);
+    if (done)
+        stack_schedule_trim(stack);
+    return done;
+}
+EXPORT_SYMBOL(int_stack_pop_batch);
+
 /* Module init & exit */
 static int __init int_stack_init(void)
 {
+    unsigned int nr_shards;
+    int ret;
+    if (blob_max_size == 0 || blob_max_size > INT_STACK_BLOB_LIMIT) {
+        printk(KERN_ERR "int_stack: blob_max_size must be 1..%u\n",
+               INT_STACK_BLOB_LIMIT);
+        return -EINVAL;
+    }
+    if (numa_shards && numa_node != NUMA_NO_NODE) {
+        printk(KERN_ERR "int_stack: numa_node and numa_shards are exclusive\n");
+        return -EINVAL;
+    }
+    if (numa_node != NUMA_NO_NODE &&
+        (numa_node < 0 || numa_node >= nr_node_ids || !node_online(numa_node))) {
+        printk(KERN_ERR "int_stack: Node %d is not online\n", numa_node);
+        return -EINVAL;
+    }
+    /* Only the payload is ever copied to or from userspace */
+    blob_cache = kmem_cache_create_usercopy("int_stack_blob",
+                        offsetof(struct int_stack_blob, data) + blob_max_size,
+                        0, SLAB_ACCOUNT,
+                        offsetof(struct int_stack_blob, data), blob_max_size,
+                        NULL);
+    if (!blob_cache)
+        return -ENOMEM;
+
+    /* Allocated up front so the exported API works before any open() */
+    nr_shards = numa_shards ? nr_node_ids : 1;
+    stack = kzalloc(struct_size(stack, shard, nr_shards), GFP_KERNEL);
+    if (!stack) {
+        ret = -ENOMEM;
+        goto err_cache;
+    }
+    stack->nr_shards = nr_shards;
+    if (stack_init(stack, DEFAULT_STACK_SIZE) != SUCCESS) {
+        ret = -ENOMEM;
+        goto err_stack;
+    }
+    INIT_DELAYED_WORK(&stack->trim_work, stack_trim_work);
+    ret = stack_register_shrinker();
+    if (ret)
+        goto err_deinit;
     printk(KERN_INFO "int_stack: Stack module loaded\n");
     return 0;
+
+err_deinit:
+    stack_deinit(stack);
+err_stack:
+    kfree(stack);
+    stack = NULL;
+err_cache:
+    kmem_cache_destroy(blob_cache);
+    return ret;
 }
 
 static void __exit int_stack_exit(void)
 {
+    stack_unregister_shrinker();
+    cancel_delayed_work_sync(&stack->trim_work);
+    stack_deinit(stack);
+    blob_clear(stack);
+    kfree(stack);
+    stack = NULL;
+    kmem_cache_destroy(blob_cache);
     printk(KERN_INFO "int_stack: Stack module unloaded\n");
 }
 
@@ -0,0 +1,20 @@
+/*
+ * int_stack.h - In-kernel interface exported by the int_stack module
+ */
+
+#ifndef INT_STACK_H
+#define INT_STACK_H
+
+/* Device node control, used by the USB key driver */
+int  int_stack_create_device(void);
+void int_stack_remove_device(void);
+void int_stack_cleanup(void);
+
+/* Batch flags */
+#define INT_STACK_NOWAIT  0x1   /* never sleep; callable from atomic context */
+
+/* Producer/consumer API for other kernel modules */
+int int_stack_push_batch(const int *values, unsigned int n, unsigned int flags);
+int int_stack_pop_batch(int *values, unsigned int n, unsigned int flags);
+
+#endif /* INT_STACK_H */
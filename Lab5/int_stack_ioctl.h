@@ -0,0 +1,85 @@
+/*
+ * int_stack_ioctl.h - ioctl interface of /dev/int_stack
+ *
+ * Shared by the int_stack module and the kernel_stack utility.
+ */
+
+#ifndef INT_STACK_IOCTL_H
+#define INT_STACK_IOCTL_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define INT_STACK_MAGIC    'S'
+#define SET_STACK_SIZE     _IOW(INT_STACK_MAGIC, 1, unsigned int)
+#define SET_READ_MODE      _IOW(INT_STACK_MAGIC, 2, unsigned int)
+#define SET_ELEM_MODE      _IOW(INT_STACK_MAGIC, 3, unsigned int)
+#define INT_STACK_CHECKPOINT _IOWR(INT_STACK_MAGIC, 4, struct int_stack_xfer)
+#define INT_STACK_RESTORE  _IOW(INT_STACK_MAGIC, 5, struct int_stack_xfer)
+#define SET_NUMA_NODE      _IOW(INT_STACK_MAGIC, 6, int)  /* -1 = any node */
+
+/* Read modes (SET_READ_MODE), per file descriptor */
+#define INT_STACK_READ_POP       0  /* read() pops one int (default) */
+#define INT_STACK_READ_SNAPSHOT  1  /* read() streams data[0..size) at f_pos */
+
+/* Element modes (SET_ELEM_MODE), per file descriptor */
+#define INT_STACK_ELEM_INT       0  /* write()/read() move one int (default) */
+#define INT_STACK_ELEM_BLOB      1  /* write()/read() move one whole blob */
+
+/* Upper bound for the blob_max_size module parameter */
+#define INT_STACK_BLOB_LIMIT     (1 << 20)
+
+/*
+ * Checkpoint/restore buffer. INT_STACK_CHECKPOINT fills addr with an image
+ * of both stacks and sets len to its size; if len is too small it fails
+ * with ENOSPC and sets len to the size needed. INT_STACK_RESTORE replaces
+ * both stacks with the image at addr.
+ */
+struct int_stack_xfer {
+    __u64 addr;
+    __u64 len;
+};
+
+/*
+ * Checkpoint image, all fields little-endian:
+ *   header
+ *   count x __le32             int stack, bottom first
+ *   blob_count x { __le32 len; __u8 data[len]; }   blob stack, bottom first
+ */
+#define INT_STACK_CKPT_MAGIC     0x4b534e49  /* "INSK" */
+#define INT_STACK_CKPT_VERSION   1
+
+struct int_stack_ckpt_header {
+    __le32 magic;
+    __le16 version;
+    __le16 header_size; /* offset of the int section */
+    __le32 max_size;    /* int stack capacity */
+    __le32 count;       /* ints in the image */
+    __le32 blob_count;  /* blobs in the image */
+    __le32 crc;         /* CRC-32 (as in zlib) of everything after the header */
+};
+
+/*
+ * io_uring passthrough (IORING_OP_URING_CMD): sqe->cmd_op values. Any
+ * command completes with -EINVAL for an unknown cmd_op or flag.
+ */
+#define INT_STACK_URING_PUSH     1  /* res: 0, -ERANGE if full, -ENOMEM if no
+                                       chunk could be allocated, -EAGAIN if
+                                       issued nonblocking and not retried */
+#define INT_STACK_URING_POP      2  /* res: 1 if *addr was filled, 0 if empty,
+                                       -EFAULT for a bad addr; WAIT pops also
+                                       -ECANCELED, or -EOPNOTSUPP before 6.7 */
+#define INT_STACK_URING_PEEK     3  /* like POP, but leaves the value */
+#define INT_STACK_URING_SIZE     4  /* res: number of ints on the stack */
+
+/* Flags for INT_STACK_URING_POP */
+#define INT_STACK_URING_WAIT     (1U << 0)  /* complete once a value arrives */
+
+/* Command payload in the SQE cmd area (16 bytes, fits a 64-byte SQE) */
+struct int_stack_uring_cmd {
+    __u64 addr;     /* POP/PEEK: user address of the int to fill */
+    __s32 value;    /* PUSH: value to push */
+    __u32 flags;    /* INT_STACK_URING_* */
+};
+
+#endif /* INT_STACK_IOCTL_H */
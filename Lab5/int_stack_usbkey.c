@@ -8,16 +8,13 @@
 #include <linux/kernel.h>
 #include <linux/usb.h>
 
+#include "int_stack.h"
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Mohamed Anas");
 MODULE_DESCRIPTION("USB key driver for int_stack character device");
 MODULE_VERSION("1.0");
 
-/* Imported functions from int_stack.c */
-extern int  int_stack_create_device(void);
-extern void int_stack_remove_device(void);
-extern void int_stack_cleanup(void);
-
 /* USB device ID table for Sony DualShock 4 */
 static struct usb_device_id ds4_table[] = {
     { USB_DEVICE(0x054c, 0x05c4) },  /* Sony DualShock 4 [CUH-ZCT1x] */
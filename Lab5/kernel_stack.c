@@ -5,26 +5,43 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <stdint.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "int_stack_ioctl.h"
 
 #define DEVICE_FILE "/dev/int_stack"
-#define INT_STACK_MAGIC 'S'
-#define SET_STACK_SIZE _IOW(INT_STACK_MAGIC, 1, unsigned int)
 
 /* Error messages */
 #define ERR_STACK_FULL "ERROR: stack is full"
 #define ERR_INVALID_SIZE "ERROR: size should be > 0"
 #define ERR_DEVICE_ACCESS "ERROR: could not access the device file. Is the module loaded?"
 #define ERR_DEVICE_IOCTL "ERROR: ioctl operation failed"
+#define ERR_BLOB_TOO_BIG "ERROR: blob is larger than blob_max_size"
 
 /* Function prototypes */
 int push(int value);
 int pop(int *value);
 int unwind();
+int dump();
 int set_size(unsigned int size);
+int set_node(int node);
+int push_blob(const char *data, size_t len);
+int pop_blob();
+int checkpoint(const char *path);
+int restore(const char *path);
+int uring_main(const char *prog, int argc, char *argv[]);
 
 int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "--uring") == 0)
+        return uring_main(argv[0], argc - 2, argv + 2);
+
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s [push VALUE | pop | unwind | set-size SIZE]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [push VALUE | pop | unwind | dump | set-size SIZE | set-node NODE | push-blob TEXT | pop-blob | checkpoint FILE | restore FILE]\n", argv[0]);
+        fprintf(stderr, "       %s --uring [push VALUE... | pop [COUNT] | pop-wait [COUNT] | peek | size]\n", argv[0]);
         return 1;
     }
 
@@ -57,6 +74,8 @@ int main(int argc, char *argv[]) {
         }
     } else if (strcmp(argv[1], "unwind") == 0) {
         return unwind();
+    } else if (strcmp(argv[1], "dump") == 0) {
+        return dump();
     } else if (strcmp(argv[1], "set-size") == 0) {
         if (argc != 3) {
             fprintf(stderr, "Usage: %s set-size SIZE\n", argv[0]);
@@ -72,9 +91,43 @@ int main(int argc, char *argv[]) {
             fprintf(stderr, "%s (error: %d)\n", ERR_DEVICE_IOCTL, result);
             return result;
         }
+    } else if (strcmp(argv[1], "set-node") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s set-node NODE\n", argv[0]);
+            return 1;
+        }
+        int result = set_node(atoi(argv[2]));
+        if (result < 0) {
+            fprintf(stderr, "%s (error: %d)\n", ERR_DEVICE_IOCTL, result);
+            return result;
+        }
+    } else if (strcmp(argv[1], "push-blob") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s push-blob TEXT\n", argv[0]);
+            return 1;
+        }
+        int result = push_blob(argv[2], strlen(argv[2]));
+        if (result == -ERANGE) {
+            fprintf(stderr, "%s\n", ERR_STACK_FULL);
+            return result;
+        } else if (result == -EMSGSIZE) {
+            fprintf(stderr, "%s\n", ERR_BLOB_TOO_BIG);
+            return result;
+        } else if (result < 0) {
+            fprintf(stderr, "ERROR: push-blob operation failed with code %d\n", result);
+            return result;
+        }
+    } else if (strcmp(argv[1], "pop-blob") == 0) {
+        return pop_blob();
+    } else if (strcmp(argv[1], "checkpoint") == 0 || strcmp(argv[1], "restore") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s %s FILE\n", argv[0], argv[1]);
+            return 1;
+        }
+        return argv[1][0] == 'c' ? checkpoint(argv[2]) : restore(argv[2]);
     } else {
         fprintf(stderr, "Unknown command: %s\n", argv[1]);
-        fprintf(stderr, "Usage: %s [push VALUE | pop | unwind | set-size SIZE]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [push VALUE | pop | unwind | dump | set-size SIZE | set-node NODE | push-blob TEXT | pop-blob | checkpoint FILE | restore FILE]\n", argv[0]);
         return 1;
     }
 
@@ -151,6 +204,60 @@ int unwind() {
     return 0;
 }
 
+/* Print all values from top to bottom without popping them */
+int dump() {
+    int fd = open(DEVICE_FILE, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s\n", ERR_DEVICE_ACCESS);
+        return -errno;
+    }
+
+    unsigned int mode = INT_STACK_READ_SNAPSHOT;
+    if (ioctl(fd, SET_READ_MODE, &mode) < 0) {
+        int saved_errno = errno;
+        fprintf(stderr, "%s (error: %d)\n", ERR_DEVICE_IOCTL, -saved_errno);
+        close(fd);
+        return -saved_errno;
+    }
+
+    /* The snapshot is data[0..size), bottom first; read it in large chunks */
+    size_t len = 0, cap = 4096;
+    int *values = malloc(cap);
+    ssize_t result;
+    while (values && (result = read(fd, (char *)values + len, cap - len)) > 0) {
+        len += result;
+        if (len == cap) {
+            int *grown = realloc(values, cap * 2);
+            if (!grown) {
+                free(values);
+                values = NULL;
+                break;
+            }
+            values = grown;
+            cap *= 2;
+        }
+    }
+    int saved_errno = errno;
+    close(fd);
+    if (!values) {
+        perror("malloc");
+        return -ENOMEM;
+    }
+    if (result < 0) {
+        free(values);
+        fprintf(stderr, "ERROR: snapshot read failed with code %d\n", -saved_errno);
+        return -saved_errno;
+    }
+
+    size_t count = len / sizeof(int);
+    for (size_t i = count; i > 0; i--)
+        printf("%d\n", values[i - 1]);
+    if (count == 0)
+        printf("NULL\n");
+    free(values);
+    return 0;
+}
+
 /* Set the maximum size of the stack */
 int set_size(unsigned int size) {
     int fd = open(DEVICE_FILE, O_RDWR);
@@ -167,4 +274,412 @@ int set_size(unsigned int size) {
         return -saved_errno;
     
     return result;
-} 
\ No newline at end of file
+} 
+
+/* Move the stack's memory to a NUMA node, -1 for any node */
+int set_node(int node) {
+    int fd = open(DEVICE_FILE, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s\n", ERR_DEVICE_ACCESS);
+        return -errno;
+    }
+
+    int result = ioctl(fd, SET_NUMA_NODE, &node);
+    int saved_errno = errno;
+    close(fd);
+
+    if (result < 0)
+        return -saved_errno;
+
+    return result;
+}
+
+/* Open the device with the given element mode */
+static int open_blob_mode(int flags) {
+    int fd = open(DEVICE_FILE, flags);
+    if (fd < 0) {
+        fprintf(stderr, "%s\n", ERR_DEVICE_ACCESS);
+        return -errno;
+    }
+
+    unsigned int mode = INT_STACK_ELEM_BLOB;
+    if (ioctl(fd, SET_ELEM_MODE, &mode) < 0) {
+        int saved_errno = errno;
+        fprintf(stderr, "%s (error: %d)\n", ERR_DEVICE_IOCTL, -saved_errno);
+        close(fd);
+        return -saved_errno;
+    }
+    return fd;
+}
+
+/* Push one blob onto the blob stack */
+int push_blob(const char *data, size_t len) {
+    int fd = open_blob_mode(O_WRONLY);
+    if (fd < 0)
+        return fd;
+
+    ssize_t result = write(fd, data, len);
+    int saved_errno = errno;
+    close(fd);
+
+    if (result < 0)
+        return -saved_errno;
+
+    return result;
+}
+
+/* Pop one blob and print it */
+int pop_blob() {
+    int fd = open_blob_mode(O_RDONLY);
+    if (fd < 0)
+        return fd;
+
+    char *buf = malloc(INT_STACK_BLOB_LIMIT);
+    if (!buf) {
+        close(fd);
+        perror("malloc");
+        return -ENOMEM;
+    }
+
+    ssize_t result = read(fd, buf, INT_STACK_BLOB_LIMIT);
+    int saved_errno = errno;
+    close(fd);
+
+    if (result < 0) {
+        free(buf);
+        fprintf(stderr, "ERROR: pop-blob operation failed with code %d\n", -saved_errno);
+        return -saved_errno;
+    }
+    if (result == 0) {
+        printf("NULL\n");
+    } else {
+        fwrite(buf, 1, result, stdout);
+        printf("\n");
+    }
+    free(buf);
+    return 0;
+}
+
+/* Save both stacks to a file with one ioctl and one write */
+int checkpoint(const char *path) {
+    int fd = open(DEVICE_FILE, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s\n", ERR_DEVICE_ACCESS);
+        return -errno;
+    }
+
+    /* Ask for the size first; retry if the stack grew in between */
+    struct int_stack_xfer xfer = { 0, 0 };
+    char *buf = NULL;
+    int result;
+    while ((result = ioctl(fd, INT_STACK_CHECKPOINT, &xfer)) < 0 && errno == ENOSPC) {
+        free(buf);
+        buf = malloc(xfer.len);
+        if (!buf) {
+            perror("malloc");
+            close(fd);
+            return -ENOMEM;
+        }
+        xfer.addr = (uintptr_t)buf;
+    }
+    int saved_errno = errno;
+    close(fd);
+    if (result < 0) {
+        free(buf);
+        fprintf(stderr, "%s (error: %d)\n", ERR_DEVICE_IOCTL, -saved_errno);
+        return -saved_errno;
+    }
+
+    FILE *out = fopen(path, "wb");
+    if (!out || fwrite(buf, 1, xfer.len, out) != xfer.len || fclose(out) != 0) {
+        perror(path);
+        free(buf);
+        return -EIO;
+    }
+    const struct int_stack_ckpt_header *h = (const void *)buf;
+    printf("Saved %u values and %u blobs to %s (%llu bytes)\n", le32toh(h->count),
+           le32toh(h->blob_count), path, (unsigned long long)xfer.len);
+    free(buf);
+    return 0;
+}
+
+/* Load both stacks back from a checkpoint file */
+int restore(const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return -errno;
+    }
+    size_t len = 0, cap = 1 << 16;
+    char *buf = malloc(cap);
+    size_t got;
+    while (buf && (got = fread(buf + len, 1, cap - len, in)) > 0) {
+        len += got;
+        if (len == cap) {
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    fclose(in);
+    if (!buf) {
+        perror("malloc");
+        return -ENOMEM;
+    }
+
+    int fd = open(DEVICE_FILE, O_RDWR);
+    if (fd < 0) {
+        free(buf);
+        fprintf(stderr, "%s\n", ERR_DEVICE_ACCESS);
+        return -errno;
+    }
+    struct int_stack_xfer xfer = { (uintptr_t)buf, len };
+    int result = ioctl(fd, INT_STACK_RESTORE, &xfer);
+    int saved_errno = errno;
+    close(fd);
+    free(buf);
+    if (result < 0) {
+        if (saved_errno == EBADMSG)
+            fprintf(stderr, "ERROR: %s is corrupted (checksum mismatch)\n", path);
+        else
+            fprintf(stderr, "%s (error: %d)\n", ERR_DEVICE_IOCTL, -saved_errno);
+        return -saved_errno;
+    }
+    printf("Restored %s\n", path);
+    return 0;
+}
+
+/* —— io_uring backend ——
+ *
+ * Commands are queued as IORING_OP_URING_CMD SQEs against /dev/int_stack,
+ * up to URING_ENTRIES at a time, and reaped from the CQ. The ring is set
+ * up with raw syscalls so no liburing is needed.
+ */
+
+#define URING_ENTRIES 256
+
+struct uring {
+    int ring_fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+    void *sq_ring, *cq_ring;
+    size_t sq_size, cq_size, sqes_size;
+};
+
+/* Unmap whatever uring_setup() mapped and close the ring */
+static void uring_teardown(struct uring *r) {
+    if (r->sq_ring != MAP_FAILED)
+        munmap(r->sq_ring, r->sq_size);
+    if (r->cq_ring != MAP_FAILED)
+        munmap(r->cq_ring, r->cq_size);
+    if (r->sqes != MAP_FAILED)
+        munmap(r->sqes, r->sqes_size);
+    close(r->ring_fd);
+}
+
+static int uring_setup(struct uring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->ring_fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->ring_fd < 0)
+        return -errno;
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    char *sq = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    r->ring_fd, IORING_OFF_SQ_RING);
+    char *cq = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    r->ring_fd, IORING_OFF_CQ_RING);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->ring_fd, IORING_OFF_SQES);
+    r->sq_ring = sq;
+    r->cq_ring = cq;
+    if (sq == MAP_FAILED || cq == MAP_FAILED || r->sqes == MAP_FAILED) {
+        int saved_errno = errno;
+        uring_teardown(r);
+        return -saved_errno;
+    }
+
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->sq_entries = p.sq_entries;
+    return 0;
+}
+
+/* Queue one stack command; the caller keeps the ring from overflowing */
+static void uring_queue(struct uring *r, int dev_fd, unsigned op,
+                        const struct int_stack_uring_cmd *cmd, uint64_t user_data) {
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = dev_fd;
+    sqe->cmd_op = op;
+    memcpy(sqe->cmd, cmd, sizeof(*cmd));
+    sqe->user_data = user_data;
+    r->sq_array[idx] = idx;
+    /* Publish the SQE before the kernel can see the new tail */
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_reap(struct uring *r, struct io_uring_cqe *cqe) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+        return 0;
+    *cqe = r->cqes[head & *r->cq_mask];
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/*
+ * Run n commands of one kind, keeping up to a ring's worth in flight, and
+ * store each result in res[i]. With stream set, values filled by pops are
+ * printed as their completions arrive.
+ */
+static int uring_run(struct uring *r, int dev_fd, unsigned op,
+                     const struct int_stack_uring_cmd *cmds, int *res,
+                     size_t n, int stream) {
+    size_t queued = 0, completed = 0;
+    unsigned in_flight = 0, to_submit = 0;
+    struct io_uring_cqe cqe;
+
+    while (completed < n) {
+        for (; queued < n && in_flight < r->sq_entries; queued++) {
+            uring_queue(r, dev_fd, op, &cmds[queued], queued);
+            in_flight++;
+            to_submit++;
+        }
+        int ret = syscall(__NR_io_uring_enter, r->ring_fd, to_submit, 1,
+                          IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        to_submit -= ret;
+        while (uring_reap(r, &cqe)) {
+            res[cqe.user_data] = cqe.res;
+            in_flight--;
+            completed++;
+            if (stream && cqe.res == 1) {
+                printf("%d\n", *(int *)(uintptr_t)cmds[cqe.user_data].addr);
+                fflush(stdout);
+            }
+        }
+    }
+    return 0;
+}
+
+int uring_main(const char *prog, int argc, char *argv[]) {
+    if (argc < 1) {
+        fprintf(stderr, "Usage: %s --uring [push VALUE... | pop [COUNT] | pop-wait [COUNT] | peek | size]\n", prog);
+        return 1;
+    }
+
+    const char *cmd = argv[0];
+    unsigned op;
+    size_t n = 1;
+    uint32_t flags = 0;
+    if (strcmp(cmd, "push") == 0) {
+        op = INT_STACK_URING_PUSH;
+        n = argc - 1;
+        if (n == 0) {
+            fprintf(stderr, "Usage: %s --uring push VALUE...\n", prog);
+            return 1;
+        }
+    } else if (strcmp(cmd, "pop") == 0 || strcmp(cmd, "pop-wait") == 0) {
+        op = INT_STACK_URING_POP;
+        if (cmd[3] == '-')
+            flags = INT_STACK_URING_WAIT;
+        if (argc > 1 && atoi(argv[1]) > 0)
+            n = atoi(argv[1]);
+    } else if (strcmp(cmd, "peek") == 0) {
+        op = INT_STACK_URING_PEEK;
+    } else if (strcmp(cmd, "size") == 0) {
+        op = INT_STACK_URING_SIZE;
+    } else {
+        fprintf(stderr, "Unknown command: %s\n", cmd);
+        return 1;
+    }
+
+    int fd = open(DEVICE_FILE, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s\n", ERR_DEVICE_ACCESS);
+        return -errno;
+    }
+
+    struct uring ring;
+    int result = uring_setup(&ring, URING_ENTRIES);
+    if (result < 0) {
+        fprintf(stderr, "ERROR: io_uring setup failed with code %d\n", result);
+        close(fd);
+        return result;
+    }
+
+    struct int_stack_uring_cmd *cmds = calloc(n, sizeof(*cmds));
+    int *values = calloc(n, sizeof(int));
+    int *res = calloc(n, sizeof(int));
+    if (!cmds || !values || !res) {
+        perror("calloc");
+        result = -ENOMEM;
+        goto out;
+    }
+    for (size_t i = 0; i < n; i++) {
+        cmds[i].addr = (uintptr_t)&values[i];
+        cmds[i].value = op == INT_STACK_URING_PUSH ? atoi(argv[i + 1]) : 0;
+        cmds[i].flags = flags;
+    }
+
+    result = uring_run(&ring, fd, op, cmds, res, n, flags & INT_STACK_URING_WAIT);
+    if (result < 0) {
+        fprintf(stderr, "ERROR: io_uring_enter failed with code %d\n", result);
+        goto out;
+    }
+
+    /* Report in submission order; pop-wait already printed as it went */
+    size_t hits = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (res[i] < 0) {
+            if (res[i] == -ERANGE)
+                fprintf(stderr, "%s\n", ERR_STACK_FULL);
+            else
+                fprintf(stderr, "ERROR: %s operation failed with code %d\n", cmd, res[i]);
+            result = res[i];
+            break;
+        }
+        if (op == INT_STACK_URING_SIZE) {
+            printf("%d\n", res[i]);
+        } else if (op != INT_STACK_URING_PUSH && res[i] == 1) {
+            if (!(flags & INT_STACK_URING_WAIT))
+                printf("%d\n", values[i]);
+            hits++;
+        }
+    }
+    if (result == 0 && op != INT_STACK_URING_PUSH && op != INT_STACK_URING_SIZE && hits == 0)
+        printf("NULL\n");
+
+out:
+    free(cmds);
+    free(values);
+    free(res);
+    uring_teardown(&ring);
+    close(fd);
+    return result;
+}
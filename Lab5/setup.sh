@@ -15,6 +15,9 @@ section() {
     echo -e "\n${BLUE}==== $1 ====${NC}"
 }
 
+# Stack contents are saved here before the modules are unloaded
+CHECKPOINT="${INT_STACK_CHECKPOINT:-/var/tmp/int_stack.ckpt}"
+
 # Get USB device path for DualShock 4 controller
 get_device_path() {
     # Look for Sony DualShock 4 controller (VID=054c, PID=05c4)
@@ -42,6 +45,12 @@ echo "Building kernel_stack userspace utility..."
 make -f Makefile.user
 
 section "Checking for loaded modules"
+# Save the current contents so reloading the modules does not lose them
+if lsmod | grep -q int_stack && [ -e /dev/int_stack ]; then
+    echo "Saving stack contents to $CHECKPOINT..."
+    sudo ./kernel_stack checkpoint "$CHECKPOINT"
+fi
+
 # Check if modules are already loaded
 if lsmod | grep -q int_stack_usbkey; then
     echo "USB key module is already loaded. Unloading it first..."
@@ -112,15 +121,24 @@ else
     exit 1
 fi
 
-section "Testing stack operations"
-echo "Setting stack size to 5..."
-./kernel_stack set-size 5
-echo "Pushing values onto the stack..."
-./kernel_stack push 10
-./kernel_stack push 20
-./kernel_stack push 30
-echo "Current stack contents:"
-./kernel_stack unwind
+if [ -f "$CHECKPOINT" ]; then
+    section "Restoring saved stack contents"
+    echo "Restoring from $CHECKPOINT..."
+    ./kernel_stack restore "$CHECKPOINT"
+    sudo rm -f "$CHECKPOINT"
+    echo "Current stack contents:"
+    ./kernel_stack dump
+else
+    section "Testing stack operations"
+    echo "Setting stack size to 5..."
+    ./kernel_stack set-size 5
+    echo "Pushing values onto the stack..."
+    ./kernel_stack push 10
+    ./kernel_stack push 20
+    ./kernel_stack push 30
+    echo "Current stack contents:"
+    ./kernel_stack unwind
+fi
 
 section "Setup complete!"
 echo -e "You can now use the ${GREEN}kernel_stack${NC} utility to interact with the stack:"
@@ -128,6 +146,8 @@ echo "  ./kernel_stack set-size <size> - Change the stack size"
 echo "  ./kernel_stack push <value>    - Push a value onto the stack"
 echo "  ./kernel_stack pop             - Pop a value from the stack"
 echo "  ./kernel_stack unwind          - Display all values in the stack"
+echo "  ./kernel_stack checkpoint FILE - Save the stack contents to FILE"
+echo "  ./kernel_stack restore FILE    - Load the stack contents from FILE"
 echo
 echo "To clean up, run: ./cleanup.sh"
 echo
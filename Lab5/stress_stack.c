@@ -0,0 +1,708 @@
+/*
+ * stress_stack.c - Concurrency stress test and history checker for /dev/int_stack
+ *
+ * Runs threads that push, pop and resize at random, each recording when
+ * every operation was invoked and when it returned. After the run the
+ * stack is drained and the whole history is checked against a sequential
+ * LIFO stack. A history can also be saved with -o and checked again later
+ * with --check.
+ *
+ * Every pushed value is unique (thread << 24 | sequence number), so a
+ * popped value identifies its push. The checker reports:
+ *   lost        pushed, but never popped, not even by the final drain
+ *   duplicated  popped more than once
+ *   phantom     popped, but never successfully pushed
+ *   early       popped before its push was even issued
+ *   order       x popped while a later-pushed y was certainly above it:
+ *               push(x) < push(y) < pop(x) < pop(y) in real time
+ *   empty       a pop found the stack empty while some value was
+ *               certainly on it for the whole pop
+ * With --relaxed the order check is skipped, for stacks that are only
+ * LIFO per shard (numa_shards=1).
+ *
+ * Resizes never go below -c, and the number of values on the stack is
+ * kept at or below it, so a resize never legitimately drops a value.
+ * The test empties the stack before it starts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "int_stack_ioctl.h"
+
+#define DEVICE_FILE "/dev/int_stack"
+
+#define MAX_THREADS  127
+#define MAX_OPS      (1 << 24)     /* sequence numbers per thread */
+#define HISTORY_TAG  "# int_stack history"
+#define MAX_EXAMPLES 5             /* violations printed per kind */
+
+enum op_type { OP_PUSH, OP_PUSH_FAIL, OP_POP, OP_POP_EMPTY, OP_RESIZE, OP_NTYPES };
+
+static const char *op_names[OP_NTYPES] = {
+    "push", "push-fail", "pop", "pop-empty", "resize"
+};
+
+/* One completed operation */
+struct op {
+    uint64_t inv;      /* ns, CLOCK_MONOTONIC, before the syscall */
+    uint64_t res;      /* ns, after it returned */
+    int      value;    /* pushed/popped value, or the new size */
+    uint8_t  type;     /* enum op_type */
+    uint8_t  thread;   /* nthreads for the final drain */
+};
+
+struct history {
+    struct op *ops;
+    size_t     count;
+    size_t     alloc;
+    int        nthreads;
+    int        nops;
+};
+
+struct config {
+    const char *device;
+    int nthreads;
+    int nops;
+    int push_pct;      /* pushes per 100 non-resize ops */
+    int resize_pm;     /* resizes per 1000 ops */
+    int capacity;      /* live values kept at or below this */
+    unsigned seed;
+};
+
+struct worker {
+    pthread_t        thread;
+    int              id;
+    int              fd;
+    struct config   *cfg;
+    struct op       *ops;
+    size_t           count;
+    int              errors;
+    pthread_barrier_t *start;
+};
+
+/* Values on the stack, or about to be: never below the real count */
+static atomic_int live;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* xorshift32, one state per thread */
+static unsigned next_rand(unsigned *state) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static int make_value(int thread, int seq) {
+    return (thread << 24) | seq;
+}
+
+/* Index of a value in per-value tables, or -1 if no worker could push it */
+static long value_index(const struct history *h, int value) {
+    int thread = (unsigned)value >> 24, seq = value & (MAX_OPS - 1);
+    if (value < 0 || thread >= h->nthreads || seq >= h->nops)
+        return -1;
+    return (long)thread * h->nops + seq;
+}
+
+static int history_add(struct history *h, const struct op *op) {
+    if (h->count == h->alloc) {
+        size_t alloc = h->alloc ? h->alloc * 2 : 4096;
+        struct op *ops = realloc(h->ops, alloc * sizeof(*ops));
+        if (!ops)
+            return -ENOMEM;
+        h->ops = ops;
+        h->alloc = alloc;
+    }
+    h->ops[h->count++] = *op;
+    return 0;
+}
+
+/* Pop one value; 1 if popped, 0 if empty, -errno on error */
+static int dev_pop(int fd, int *value) {
+    ssize_t n = read(fd, value, sizeof(*value));
+    if (n < 0)
+        return -errno;
+    return n == sizeof(*value);
+}
+
+static int dev_push(int fd, int value) {
+    return write(fd, &value, sizeof(value)) == sizeof(value) ? 0 : -errno;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct config *cfg = w->cfg;
+    unsigned rng = cfg->seed * 2654435761u + w->id + 1;
+    int seq = 0;
+
+    pthread_barrier_wait(w->start);
+    for (int i = 0; i < cfg->nops; i++) {
+        struct op *op = &w->ops[w->count];
+        unsigned r = next_rand(&rng);
+        int ret;
+
+        op->thread = w->id;
+        if (r % 1000 < (unsigned)cfg->resize_pm) {
+            unsigned size = cfg->capacity + next_rand(&rng) % (cfg->capacity + 1);
+            op->type = OP_RESIZE;
+            op->value = size;
+            op->inv = now_ns();
+            ret = ioctl(w->fd, SET_STACK_SIZE, &size);
+            op->res = now_ns();
+            if (ret < 0) {
+                w->errors++;
+                continue;
+            }
+        } else if ((r >> 10) % 100 < (unsigned)cfg->push_pct &&
+                   atomic_fetch_add(&live, 1) < cfg->capacity) {
+            op->value = make_value(w->id, seq++);
+            op->inv = now_ns();
+            ret = dev_push(w->fd, op->value);
+            op->res = now_ns();
+            op->type = ret == 0 ? OP_PUSH : OP_PUSH_FAIL;
+            if (ret < 0) {
+                atomic_fetch_sub(&live, 1);
+                w->errors++;
+            }
+        } else {
+            /* A push over the limit turns into a pop */
+            if ((r >> 10) % 100 < (unsigned)cfg->push_pct)
+                atomic_fetch_sub(&live, 1);
+            op->inv = now_ns();
+            ret = dev_pop(w->fd, &op->value);
+            op->res = now_ns();
+            if (ret < 0) {
+                w->errors++;
+                continue;
+            }
+            op->type = ret ? OP_POP : OP_POP_EMPTY;
+            if (ret)
+                atomic_fetch_sub(&live, 1);
+        }
+        w->count++;
+    }
+    return NULL;
+}
+
+/* Pop until empty; recorded as thread nthreads when h is given */
+static int drain(int fd, struct history *h, int thread) {
+    struct op op = { .thread = thread, .type = OP_POP };
+    int ret, count = 0;
+    for (;;) {
+        op.inv = now_ns();
+        ret = dev_pop(fd, &op.value);
+        op.res = now_ns();
+        if (ret <= 0)
+            return ret < 0 ? ret : count;
+        count++;
+        if (h && history_add(h, &op) < 0)
+            return -ENOMEM;
+    }
+}
+
+static int run_stress(struct config *cfg, struct history *h) {
+    struct worker *workers = calloc(cfg->nthreads, sizeof(*workers));
+    pthread_barrier_t start;
+    uint64_t begin, end;
+    size_t counts[OP_NTYPES] = { 0 };
+    uint64_t latency[OP_NTYPES] = { 0 };
+    int fd, ret = 0, errors = 0;
+
+    if (!workers)
+        return -ENOMEM;
+    fd = open(cfg->device, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: could not open %s: %s\n", cfg->device, strerror(errno));
+        free(workers);
+        return -errno;
+    }
+
+    /* Start from an empty stack with room for every live value */
+    unsigned size = 2 * cfg->capacity;
+    if (ioctl(fd, SET_STACK_SIZE, &size) < 0) {
+        ret = -errno;
+        fprintf(stderr, "ERROR: SET_STACK_SIZE failed: %s\n", strerror(errno));
+        goto out;
+    }
+    ret = drain(fd, NULL, 0);
+    if (ret < 0)
+        goto out;
+    if (ret > 0)
+        fprintf(stderr, "Discarded %d values already on the stack\n", ret);
+
+    pthread_barrier_init(&start, NULL, cfg->nthreads + 1);
+    for (int i = 0; i < cfg->nthreads; i++) {
+        struct worker *w = &workers[i];
+        w->id = i;
+        w->cfg = cfg;
+        w->start = &start;
+        w->ops = malloc(sizeof(*w->ops) * cfg->nops);
+        w->fd = open(cfg->device, O_RDWR);
+        if (!w->ops || w->fd < 0 ||
+            pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            fprintf(stderr, "ERROR: could not start thread %d\n", i);
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start);
+    begin = now_ns();
+    for (int i = 0; i < cfg->nthreads; i++)
+        pthread_join(workers[i].thread, NULL);
+    end = now_ns();
+
+    for (int i = 0; i < cfg->nthreads; i++) {
+        struct worker *w = &workers[i];
+        for (size_t j = 0; j < w->count; j++) {
+            counts[w->ops[j].type]++;
+            latency[w->ops[j].type] += w->ops[j].res - w->ops[j].inv;
+            if (history_add(h, &w->ops[j]) < 0) {
+                ret = -ENOMEM;
+                goto out;
+            }
+        }
+        errors += w->errors;
+        close(w->fd);
+        free(w->ops);
+    }
+    pthread_barrier_destroy(&start);
+
+    /* Everything still on the stack must be there; collect it */
+    ret = drain(fd, h, cfg->nthreads);
+    if (ret < 0)
+        goto out;
+
+    size_t total = 0;
+    for (int t = 0; t < OP_NTYPES; t++)
+        total += counts[t];
+    double secs = (end - begin) / 1e9;
+    printf("threads %d  ops %zu  time %.3f s  throughput %.0f ops/s\n",
+           cfg->nthreads, total, secs, total / secs);
+    for (int t = 0; t < OP_NTYPES; t++)
+        if (counts[t])
+            printf("  %-9s %10zu  avg %8.2f us\n", op_names[t], counts[t],
+                   latency[t] / 1e3 / counts[t]);
+    printf("  drained   %10d\n", ret);
+    if (errors)
+        printf("  errors    %10d\n", errors);
+    ret = 0;
+out:
+    close(fd);
+    free(workers);
+    return ret;
+}
+
+static int save_history(const struct history *h, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "ERROR: could not open %s: %s\n", path, strerror(errno));
+        return -errno;
+    }
+    fprintf(f, "%s: threads %d ops %d\n", HISTORY_TAG, h->nthreads, h->nops);
+    for (size_t i = 0; i < h->count; i++) {
+        const struct op *op = &h->ops[i];
+        if (op->type == OP_POP_EMPTY)
+            fprintf(f, "%d %s - %llu %llu\n", op->thread, op_names[op->type],
+                    (unsigned long long)op->inv, (unsigned long long)op->res);
+        else
+            fprintf(f, "%d %s %d %llu %llu\n", op->thread, op_names[op->type],
+                    op->value, (unsigned long long)op->inv,
+                    (unsigned long long)op->res);
+    }
+    if (fclose(f) != 0)
+        return -errno;
+    return 0;
+}
+
+static int load_history(struct history *h, const char *path) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    char line[256], name[16], value[16];
+    unsigned long long inv, res;
+    int thread, lineno = 1, ret = 0;
+
+    if (!f) {
+        fprintf(stderr, "ERROR: could not open %s: %s\n", path, strerror(errno));
+        return -errno;
+    }
+    if (!fgets(line, sizeof(line), f) ||
+        sscanf(line, HISTORY_TAG ": threads %d ops %d", &h->nthreads, &h->nops) != 2 ||
+        h->nthreads < 1 || h->nthreads > MAX_THREADS ||
+        h->nops < 1 || h->nops > MAX_OPS) {
+        fprintf(stderr, "ERROR: %s is not a stress_stack history\n", path);
+        ret = -EINVAL;
+        goto out;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        struct op op = { 0 };
+        int t;
+        lineno++;
+        if (sscanf(line, "%d %15s %15s %llu %llu", &thread, name, value, &inv, &res) != 5)
+            goto bad;
+        for (t = 0; t < OP_NTYPES && strcmp(name, op_names[t]) != 0; t++)
+            ;
+        if (t == OP_NTYPES || thread < 0 || thread > h->nthreads)
+            goto bad;
+        op.type = t;
+        op.thread = thread;
+        op.value = t == OP_POP_EMPTY ? 0 : atoi(value);
+        op.inv = inv;
+        op.res = res;
+        if (history_add(h, &op) < 0) {
+            ret = -ENOMEM;
+            goto out;
+        }
+    }
+    goto out;
+bad:
+    fprintf(stderr, "ERROR: %s:%d: malformed line\n", path, lineno);
+    ret = -EINVAL;
+out:
+    if (f != stdin)
+        fclose(f);
+    return ret;
+}
+
+/* —— Checker —— */
+
+#define NEVER UINT64_MAX
+
+/* Life of one value; NEVER where the operation did not happen */
+struct value_life {
+    uint64_t push_inv, push_res;
+    uint64_t pop_inv, pop_res;
+    int      pops;
+    int      failed_push;
+};
+
+struct span {
+    uint64_t key;
+    long     index;
+};
+
+static int cmp_span(const void *a, const void *b) {
+    const struct span *x = a, *y = b;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    const uint64_t *x = a, *y = b;
+    return *x < *y ? -1 : *x > *y;
+}
+
+/* Number of elements of sorted[0..n) that are <= key */
+static size_t count_le(const uint64_t *sorted, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (sorted[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void report(const char *kind, long *count, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void report(const char *kind, long *count, const char *fmt, ...) {
+    if (++*count <= MAX_EXAMPLES) {
+        va_list ap;
+        printf("  %-10s ", kind);
+        va_start(ap, fmt);
+        vprintf(fmt, ap);
+        va_end(ap);
+        printf("\n");
+    }
+}
+
+/*
+ * The order check: for each popped x, is there a y with
+ *   push(x).res < push(y).inv, push(y).res < pop(x).inv, pop(x).res < pop(y).inv?
+ * Sweeping x by pop(x).inv, every y with push(y).res < pop(x).inv is
+ * inserted into a Fenwick tree keyed by push(y).inv (reversed, so that a
+ * prefix is "pushed after t") holding the latest pop(y).inv. One query per
+ * x then finds the y that stayed longest. O(n log n) overall.
+ */
+static long check_order(const struct history *h, struct value_life *life, long nvalues) {
+    struct span *xs = malloc(sizeof(*xs) * nvalues);
+    struct span *ys = malloc(sizeof(*ys) * nvalues);
+    uint64_t *keys = malloc(sizeof(*keys) * nvalues);
+    uint64_t *tree = NULL;
+    long *who = NULL, n = 0, violations = 0;
+
+    if (!xs || !ys || !keys)
+        goto out;
+    for (long i = 0; i < nvalues; i++) {
+        if (life[i].pops != 1 || life[i].push_inv == NEVER)
+            continue;
+        xs[n] = (struct span){ life[i].pop_inv, i };
+        ys[n] = (struct span){ life[i].push_res, i };
+        keys[n] = life[i].push_inv;
+        n++;
+    }
+    qsort(xs, n, sizeof(*xs), cmp_span);
+    qsort(ys, n, sizeof(*ys), cmp_span);
+    qsort(keys, n, sizeof(*keys), cmp_u64);
+    tree = calloc(n + 1, sizeof(*tree));
+    who = calloc(n + 1, sizeof(*who));
+    if (!tree || !who)
+        goto out;
+
+    for (long i = 0, j = 0; i < n; i++) {
+        struct value_life *x = &life[xs[i].index];
+        for (; j < n && ys[j].key < x->pop_inv; j++) {
+            struct value_life *y = &life[ys[j].index];
+            /* Reversed rank: 1 for the latest push(y).inv */
+            long pos = n - (long)count_le(keys, n, y->push_inv) + 1;
+            for (; pos <= n; pos += pos & -pos)
+                if (y->pop_inv > tree[pos] || !who[pos]) {
+                    tree[pos] = y->pop_inv;
+                    who[pos] = ys[j].index + 1;
+                }
+        }
+        /* Only ys pushed after push(x) returned */
+        long pos = n - (long)count_le(keys, n, x->push_res);
+        uint64_t best = 0;
+        long witness = 0;
+        for (; pos > 0; pos -= pos & -pos)
+            if (who[pos] && tree[pos] > best) {
+                best = tree[pos];
+                witness = who[pos];
+            }
+        if (witness && best > x->pop_res) {
+            long xi = xs[i].index, yi = witness - 1;
+            report("order", &violations,
+                   "%ld (thread %ld) popped while %ld (thread %ld) was on top of it",
+                   xi % h->nops, xi / h->nops, yi % h->nops, yi / h->nops);
+        }
+    }
+out:
+    if (n && (!tree || !who)) {
+        fprintf(stderr, "ERROR: out of memory, order not checked\n");
+        violations = -1;
+    }
+    free(xs);
+    free(ys);
+    free(keys);
+    free(tree);
+    free(who);
+    return violations;
+}
+
+/*
+ * The empty check: a pop that found the stack empty is wrong if some value
+ * was pushed before the pop began and not popped before it ended. Sweep
+ * the empty pops by invocation, adding values by push(v).res, and keep the
+ * latest pop(v).inv seen. Lost values are left out; they are reported
+ * already and would otherwise flag every later empty pop.
+ */
+static long check_empty(const struct history *h, struct value_life *life, long nvalues) {
+    struct span *vs = malloc(sizeof(*vs) * nvalues);
+    struct span *es = malloc(sizeof(*es) * h->count);
+    long n = 0, ne = 0, violations = 0;
+    uint64_t latest = 0;
+    long holder = -1;
+
+    if (!vs || !es) {
+        free(vs);
+        free(es);
+        fprintf(stderr, "ERROR: out of memory, empty pops not checked\n");
+        return -1;
+    }
+    for (long i = 0; i < nvalues; i++)
+        if (life[i].push_res != NEVER && life[i].pops)
+            vs[n++] = (struct span){ life[i].push_res, i };
+    for (size_t i = 0; i < h->count; i++)
+        if (h->ops[i].type == OP_POP_EMPTY)
+            es[ne++] = (struct span){ h->ops[i].inv, (long)i };
+    qsort(vs, n, sizeof(*vs), cmp_span);
+    qsort(es, ne, sizeof(*es), cmp_span);
+
+    for (long i = 0, j = 0; i < ne; i++) {
+        const struct op *e = &h->ops[es[i].index];
+        for (; j < n && vs[j].key < e->inv; j++) {
+            uint64_t gone = life[vs[j].index].pop_inv;
+            if (holder < 0 || gone > latest) {
+                latest = gone;
+                holder = vs[j].index;
+            }
+        }
+        if (holder >= 0 && latest > e->res)
+            report("empty", &violations,
+                   "thread %d found the stack empty while %ld (thread %ld) was on it",
+                   e->thread, holder % h->nops, holder / h->nops);
+    }
+    free(vs);
+    free(es);
+    return violations;
+}
+
+/* Returns 0 if the history is consistent, 1 if not, -errno on error */
+static int check_history(const struct history *h, int relaxed) {
+    long nvalues = (long)h->nthreads * h->nops;
+    struct value_life *life = malloc(sizeof(*life) * nvalues);
+    long lost = 0, duplicated = 0, phantom = 0, early = 0, order = 0, empty;
+
+    if (!life)
+        return -ENOMEM;
+    for (long i = 0; i < nvalues; i++)
+        life[i] = (struct value_life){ NEVER, NEVER, NEVER, NEVER, 0, 0 };
+
+    printf("check (%s):\n", relaxed ? "no order" : "LIFO");
+    for (size_t i = 0; i < h->count; i++) {
+        const struct op *op = &h->ops[i];
+        long v;
+        if (op->type == OP_RESIZE || op->type == OP_POP_EMPTY)
+            continue;
+        v = value_index(h, op->value);
+        if (op->type == OP_PUSH || op->type == OP_PUSH_FAIL) {
+            if (v < 0)
+                continue;
+            if (op->type == OP_PUSH_FAIL) {
+                life[v].failed_push = 1;
+                continue;
+            }
+            life[v].push_inv = op->inv;
+            life[v].push_res = op->res;
+            continue;
+        }
+        if (v < 0) {
+            report("phantom", &phantom, "%d popped by thread %d, never pushed",
+                   op->value, op->thread);
+            continue;
+        }
+        if (++life[v].pops > 1) {
+            report("duplicated", &duplicated, "%ld (thread %ld) popped %d times",
+                   v % h->nops, v / h->nops, life[v].pops);
+            continue;
+        }
+        life[v].pop_inv = op->inv;
+        life[v].pop_res = op->res;
+    }
+
+    for (long v = 0; v < nvalues; v++) {
+        if (life[v].pops && life[v].push_inv == NEVER)
+            report("phantom", &phantom, "%ld (thread %ld) popped, %s",
+                   v % h->nops, v / h->nops,
+                   life[v].failed_push ? "but its push failed" : "never pushed");
+        else if (life[v].push_inv != NEVER && !life[v].pops)
+            report("lost", &lost, "%ld (thread %ld) pushed, never popped",
+                   v % h->nops, v / h->nops);
+        else if (life[v].pops && life[v].pop_res < life[v].push_inv)
+            report("early", &early, "%ld (thread %ld) popped before it was pushed",
+                   v % h->nops, v / h->nops);
+    }
+    if (!relaxed)
+        order = check_order(h, life, nvalues);
+    empty = check_empty(h, life, nvalues);
+    free(life);
+    if (order < 0 || empty < 0)
+        return -ENOMEM;
+
+    printf("  lost %ld  duplicated %ld  phantom %ld  early %ld  order %ld  empty %ld\n",
+           lost, duplicated, phantom, early, order, empty);
+    if (lost + duplicated + phantom + early + order + empty) {
+        printf("FAILED\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-t THREADS] [-n OPS] [-p PUSH%%] [-r RESIZE] [-c CAP] [-s SEED]\n"
+            "          [-D DEVICE] [-o HISTORY] [--relaxed]\n"
+            "       %s --check HISTORY [--relaxed]\n"
+            "\n"
+            "  -t THREADS  worker threads (default 4, at most %d)\n"
+            "  -n OPS      operations per thread (default 100000)\n"
+            "  -p PUSH%%    share of pushes among pushes and pops (default 50)\n"
+            "  -r RESIZE   SET_STACK_SIZE calls per 1000 operations (default 1)\n"
+            "  -c CAP      most values kept on the stack; resizes pick CAP..2*CAP (default 512)\n"
+            "  -s SEED     random seed (default: time)\n"
+            "  -D DEVICE   device to test (default %s); its contents are discarded\n"
+            "  -o HISTORY  also save the history to a file\n"
+            "  --relaxed   skip the LIFO order check (for numa_shards=1)\n"
+            "  --check     check a saved history (- for stdin) instead of running\n",
+            prog, prog, MAX_THREADS, DEVICE_FILE);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option longopts[] = {
+        { "check",   required_argument, NULL, 'k' },
+        { "relaxed", no_argument,       NULL, 'R' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct config cfg = {
+        .device = DEVICE_FILE, .nthreads = 4, .nops = 100000,
+        .push_pct = 50, .resize_pm = 1, .capacity = 512,
+        .seed = (unsigned)time(NULL),
+    };
+    struct history h = { 0 };
+    const char *check = NULL, *save = NULL;
+    int relaxed = 0, opt, ret;
+
+    while ((opt = getopt_long(argc, argv, "t:n:p:r:c:s:D:o:h", longopts, NULL)) != -1) {
+        switch (opt) {
+        case 't': cfg.nthreads = atoi(optarg); break;
+        case 'n': cfg.nops = atoi(optarg); break;
+        case 'p': cfg.push_pct = atoi(optarg); break;
+        case 'r': cfg.resize_pm = atoi(optarg); break;
+        case 'c': cfg.capacity = atoi(optarg); break;
+        case 's': cfg.seed = strtoul(optarg, NULL, 0); break;
+        case 'D': cfg.device = optarg; break;
+        case 'o': save = optarg; break;
+        case 'k': check = optarg; break;
+        case 'R': relaxed = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc || cfg.nthreads < 1 || cfg.nthreads > MAX_THREADS ||
+        cfg.nops < 1 || cfg.nops > MAX_OPS || cfg.push_pct < 0 ||
+        cfg.push_pct > 100 || cfg.resize_pm < 0 || cfg.resize_pm > 1000 ||
+        cfg.capacity < 1 || cfg.capacity > INT32_MAX / 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (check) {
+        ret = load_history(&h, check);
+    } else {
+        h.nthreads = cfg.nthreads;
+        h.nops = cfg.nops;
+        printf("seed %u\n", cfg.seed);
+        ret = run_stress(&cfg, &h);
+        if (ret == 0 && save)
+            ret = save_history(&h, save);
+    }
+    if (ret == 0)
+        ret = check_history(&h, relaxed);
+    free(h.ops);
+    if (ret < 0) {
+        fprintf(stderr, "ERROR: %s\n", strerror(-ret));
+        return 2;
+    }
+    return ret;
+}